@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "lib/tape/writer/tape_writer.hpp"
+
+namespace tape::bench {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Distribution of generated elements.
+////////////////////////////////////////////////////////////////////////////////
+enum class Distribution : uint8_t {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Uniformly random elements.
+  //////////////////////////////////////////////////////////////////////////////
+  kRandom,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Elements in ascending order.
+  //////////////////////////////////////////////////////////////////////////////
+  kSorted,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Elements in descending order.
+  //////////////////////////////////////////////////////////////////////////////
+  kReverse,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Random elements out of kFewUniqueNumber values.
+  //////////////////////////////////////////////////////////////////////////////
+  kFewUnique,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Elements out of kZipfValuesNumber values with Zipf's law: the k-th
+  /// most frequent value occurs about 1 / k times as often as the first.
+  //////////////////////////////////////////////////////////////////////////////
+  kZipf
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Number of values of kFewUnique.
+////////////////////////////////////////////////////////////////////////////////
+inline constexpr uint32_t kFewUniqueNumber = 16;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Number of values of kZipf.
+////////////////////////////////////////////////////////////////////////////////
+inline constexpr uint32_t kZipfValuesNumber = 10000;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Parse the distribution from its name: "random", "sorted",
+/// "reverse", "few_unique" or "zipf". Throws std::invalid_argument for other
+/// names.
+///
+/// \param name name of the distribution.
+/// \return distribution.
+////////////////////////////////////////////////////////////////////////////////
+[[nodiscard]] inline Distribution ParseDistribution(const std::string &name) {
+  if (name == "random") {
+    return Distribution::kRandom;
+  }
+  if (name == "sorted") {
+    return Distribution::kSorted;
+  }
+  if (name == "reverse") {
+    return Distribution::kReverse;
+  }
+  if (name == "few_unique") {
+    return Distribution::kFewUnique;
+  }
+  if (name == "zipf") {
+    return Distribution::kZipf;
+  }
+  throw std::invalid_argument("Unknown distribution: " + name);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Get the name of the distribution.
+///
+/// \param distribution distribution.
+/// \return name of the distribution.
+////////////////////////////////////////////////////////////////////////////////
+[[nodiscard]] inline std::string GetDistributionName(Distribution distribution) {
+  switch (distribution) {
+    case Distribution::kRandom:
+      return "random";
+    case Distribution::kSorted:
+      return "sorted";
+    case Distribution::kReverse:
+      return "reverse";
+    case Distribution::kFewUnique:
+      return "few_unique";
+    case Distribution::kZipf:
+      return "zipf";
+  }
+  return "unknown";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Generator of elements with the given distribution. Elements are
+/// made one by one, so tapes of any size can be generated.
+/// \tparam T type of elements.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+class DataGenerator {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief DataGenerator constructor.
+  ///
+  /// \param distribution distribution of elements.
+  /// \param size number of elements.
+  /// \param seed seed of the random generator.
+  //////////////////////////////////////////////////////////////////////////////
+  DataGenerator(Distribution distribution, TapeSize size, uint32_t seed = 1);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Make the next element.
+  ///
+  /// \return element.
+  //////////////////////////////////////////////////////////////////////////////
+  T Next();
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Map a number of the order of elements onto the type.
+  ///
+  /// \param number number in [0, size).
+  /// \return element.
+  //////////////////////////////////////////////////////////////////////////////
+  T FromNumber(uint64_t number) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Distribution of elements.
+  //////////////////////////////////////////////////////////////////////////////
+  Distribution distribution_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of elements.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeSize size_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of elements made.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeSize made_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Random generator.
+  //////////////////////////////////////////////////////////////////////////////
+  std::mt19937_64 random_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Cumulative probabilities of the values of kZipf.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<double> zipf_cdf_;
+};
+
+template <typename T>
+DataGenerator<T>::DataGenerator(Distribution distribution, TapeSize size,
+                                uint32_t seed)
+    : distribution_(distribution), size_(size), random_(seed) {
+  if (distribution_ == Distribution::kZipf) {
+    zipf_cdf_.resize(kZipfValuesNumber);
+    double sum = 0;
+    for (uint32_t k = 0; k < kZipfValuesNumber; k++) {
+      sum += 1.0 / (k + 1);
+      zipf_cdf_[k] = sum;
+    }
+    for (double &probability : zipf_cdf_) {
+      probability /= sum;
+    }
+  }
+}
+
+template <typename T>
+T DataGenerator<T>::Next() {
+  uint64_t number = made_++;
+  switch (distribution_) {
+    case Distribution::kRandom:
+      if constexpr (std::is_floating_point_v<T>) {
+        return std::uniform_real_distribution<T>(-1e9, 1e9)(random_);
+      } else {
+        return std::uniform_int_distribution<T>(
+            std::numeric_limits<T>::min(),
+            std::numeric_limits<T>::max())(random_);
+      }
+    case Distribution::kSorted:
+      return FromNumber(number);
+    case Distribution::kReverse:
+      return FromNumber(size_ - 1 - number);
+    case Distribution::kFewUnique:
+      return FromNumber(std::uniform_int_distribution<uint64_t>(
+          0, kFewUniqueNumber - 1)(random_) * (size_ / kFewUniqueNumber));
+    case Distribution::kZipf: {
+      double probability = std::uniform_real_distribution<double>(0, 1)(random_);
+      auto value = std::lower_bound(zipf_cdf_.begin(), zipf_cdf_.end(),
+                                    probability) -
+                   zipf_cdf_.begin();
+      return FromNumber(static_cast<uint64_t>(value) * 7919 %
+                        kZipfValuesNumber);
+    }
+  }
+  return T{};
+}
+
+template <typename T>
+T DataGenerator<T>::FromNumber(uint64_t number) const {
+  if constexpr (std::is_signed_v<T>) {
+    return static_cast<T>(static_cast<int64_t>(number) -
+                          static_cast<int64_t>(size_ / 2));
+  } else {
+    return static_cast<T>(number);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Write a tape of generated elements.
+///
+/// \tparam T type of elements.
+/// \param path path to the file of the tape.
+/// \param size number of elements.
+/// \param distribution distribution of elements.
+/// \param format format of the file.
+/// \param seed seed of the random generator.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void GenerateTape(const std::filesystem::path &path, TapeSize size,
+                  Distribution distribution, TapeFormat format,
+                  uint32_t seed = 1) {
+  static constexpr ChunkSize kBufferSize = 1 << 16;
+  DataGenerator<T> generator(distribution, size, seed);
+  TapeWriter<T> writer{path, kBufferSize, Delays{}, format};
+  for (TapeSize i = 0; i < size; i++) {
+    writer.Write(generator.Next());
+  }
+  writer.Close();
+}
+}  // namespace tape::bench
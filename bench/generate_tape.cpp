@@ -0,0 +1,38 @@
+#include <iostream>
+#include <string>
+
+#include "bench/data_generator.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Generate an input tape for benchmarks:
+/// tape_data_generator <path> <N> <distribution> [int32|int64|double]
+/// [text|binary]
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0]
+              << " <path> <N> <random|sorted|reverse|few_unique|zipf>"
+                 " [int32|int64|double] [text|binary]\n";
+    return 1;
+  }
+  const std::filesystem::path path = argv[1];
+  const auto size = static_cast<tape::TapeSize>(std::stoul(argv[2]));
+  const tape::bench::Distribution distribution =
+      tape::bench::ParseDistribution(argv[3]);
+  const std::string type = argc > 4 ? argv[4] : "int32";
+  const tape::TapeFormat format = argc > 5 && std::string(argv[5]) == "binary"
+                                      ? tape::TapeFormat::kBinary
+                                      : tape::TapeFormat::kText;
+
+  if (type == "int32") {
+    tape::bench::GenerateTape<int32_t>(path, size, distribution, format);
+  } else if (type == "int64") {
+    tape::bench::GenerateTape<int64_t>(path, size, distribution, format);
+  } else if (type == "double") {
+    tape::bench::GenerateTape<double>(path, size, distribution, format);
+  } else {
+    std::cerr << "Unknown element type: " << type << '\n';
+    return 1;
+  }
+  return 0;
+}
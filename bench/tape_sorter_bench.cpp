@@ -0,0 +1,212 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "bench/data_generator.hpp"
+#include "lib/tape/sorter/tape_sorter.hpp"
+
+namespace {
+using tape::bench::Distribution;
+
+const std::filesystem::path kDataDir = "./bench_data";
+
+template <typename T>
+std::string GetTypeName() {
+  if constexpr (std::is_same_v<T, int32_t>) {
+    return "int32";
+  } else if constexpr (std::is_same_v<T, int64_t>) {
+    return "int64";
+  } else {
+    return "double";
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Get the binary input tape of the benchmark. It is generated on the
+/// first use and kept in kDataDir for the next runs.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+std::filesystem::path GetInput(tape::TapeSize size,
+                               Distribution distribution) {
+  std::filesystem::path path =
+      kDataDir / (GetTypeName<T>() + "_" +
+                  tape::bench::GetDistributionName(distribution) + "_" +
+                  std::to_string(size) + ".bin");
+  if (!std::filesystem::exists(path)) {
+    std::filesystem::create_directories(kDataDir);
+    tape::bench::GenerateTape<T>(path, size, distribution,
+                                 tape::TapeFormat::kBinary);
+  }
+  return path;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Sort the input tape of the benchmark arguments: N, M and the
+/// distribution.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+tape::SortStats SortInput(benchmark::State &state) {
+  auto size = static_cast<tape::TapeSize>(state.range(0));
+  auto memory = static_cast<tape::MemorySize>(state.range(1));
+  auto distribution = static_cast<Distribution>(state.range(2));
+
+  tape::Tape<T> tape_in(GetInput<T>(size, distribution), size, memory,
+                        tape::Delays{}, tape::TapeFormat::kBinary);
+  tape::Tape<T> tape_out(kDataDir / "sorted.bin", tape::Delays{},
+                         tape::TapeFormat::kBinary);
+  tape::TapeSorter<T> sorter(tape_in, tape_out);
+  return sorter.Sort();
+}
+
+void SetCounters(benchmark::State &state, std::size_t element_size) {
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * state.range(0) * element_size);
+  state.SetLabel(tape::bench::GetDistributionName(
+      static_cast<Distribution>(state.range(2))));
+}
+
+template <typename T>
+void BM_Sort(benchmark::State &state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(SortInput<T>(state));
+  }
+  SetCounters(state, sizeof(T));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Splitting into runs: every chunk goes through MakeSplitTape.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void BM_Split(benchmark::State &state) {
+  for (auto _ : state) {
+    tape::SortStats stats = SortInput<T>(state);
+    state.SetIterationTime(
+        std::chrono::duration<double>(stats.phases_.front().wall_time_)
+            .count());
+  }
+  SetCounters(state, sizeof(T));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Merging runs: the merge passes and the final merge.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void BM_Merge(benchmark::State &state) {
+  for (auto _ : state) {
+    tape::SortStats stats = SortInput<T>(state);
+    std::chrono::nanoseconds merge_time{};
+    for (std::size_t i = 1; i < stats.phases_.size(); i++) {
+      merge_time += stats.phases_[i].wall_time_;
+    }
+    state.SetIterationTime(std::chrono::duration<double>(merge_time).count());
+  }
+  SetCounters(state, sizeof(T));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Sorting a run in memory: SortRun against std::sort.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T, bool kStdSort>
+void BM_SortRun(benchmark::State &state) {
+  auto size = static_cast<std::size_t>(state.range(0));
+  auto distribution = static_cast<Distribution>(state.range(1));
+  tape::bench::DataGenerator<T> generator(distribution, size);
+  std::vector<T> input(size);
+  for (T &element : input) {
+    element = generator.Next();
+  }
+  std::vector<T> run(size);
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::copy(input.begin(), input.end(), run.begin());
+    state.ResumeTiming();
+    if constexpr (kStdSort) {
+      std::sort(run.begin(), run.end());
+    } else {
+      tape::SortRun<T>(run);
+    }
+    benchmark::DoNotOptimize(run.data());
+  }
+  state.SetItemsProcessed(state.iterations() * size);
+  state.SetLabel(tape::bench::GetDistributionName(distribution));
+}
+
+template <typename T>
+void BM_WriteToCell(benchmark::State &state) {
+  auto size = static_cast<tape::TapeSize>(state.range(0));
+  std::filesystem::create_directories(kDataDir);
+  std::filesystem::path path = kDataDir / "written.bin";
+  tape::bench::DataGenerator<T> generator(Distribution::kRandom, size);
+  for (auto _ : state) {
+    std::filesystem::remove(path);
+    tape::Tape<T> tape(path, size, static_cast<tape::MemorySize>(
+                                       state.range(1)),
+                       tape::Delays{}, tape::TapeFormat::kBinary);
+    for (tape::TapeSize i = 0; i < size; i++) {
+      tape.WriteToCell(generator.Next());
+      tape.MoveLeft();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * size);
+}
+
+template <typename T>
+void BM_MoveLeftScan(benchmark::State &state) {
+  auto size = static_cast<tape::TapeSize>(state.range(0));
+  std::filesystem::path path = GetInput<T>(size, Distribution::kRandom);
+  for (auto _ : state) {
+    tape::Tape<T> tape(path, size, static_cast<tape::MemorySize>(
+                                       state.range(1)),
+                       tape::Delays{}, tape::TapeFormat::kBinary);
+    T sum{};
+    for (tape::TapeSize i = 0; i < size; i++) {
+      sum += tape.ReadCell();
+      tape.MoveLeft();
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * size);
+  state.SetBytesProcessed(state.iterations() * size * sizeof(T));
+}
+
+void SortArguments(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgNames({"N", "M", "distribution"})
+      ->ArgsProduct({{1 << 16, 1 << 20},
+                     {1 << 14, 1 << 18},
+                     benchmark::CreateDenseRange(
+                         0, static_cast<int64_t>(Distribution::kZipf), 1)})
+      ->Unit(benchmark::kMillisecond);
+}
+
+void RunArguments(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgNames({"N", "distribution"})
+      ->ArgsProduct({{1 << 16, 1 << 22},
+                     benchmark::CreateDenseRange(
+                         0, static_cast<int64_t>(Distribution::kZipf), 1)})
+      ->Unit(benchmark::kMillisecond);
+}
+
+void TapeArguments(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgNames({"N", "M"})
+      ->ArgsProduct({{1 << 14, 1 << 18}, {1 << 14, 1 << 18}})
+      ->Unit(benchmark::kMillisecond);
+}
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_Sort, int32_t)->Apply(SortArguments);
+BENCHMARK_TEMPLATE(BM_Sort, int64_t)->Apply(SortArguments);
+BENCHMARK_TEMPLATE(BM_Sort, double)->Apply(SortArguments);
+BENCHMARK_TEMPLATE(BM_Split, int32_t)->Apply(SortArguments)->UseManualTime();
+BENCHMARK_TEMPLATE(BM_Merge, int32_t)->Apply(SortArguments)->UseManualTime();
+BENCHMARK_TEMPLATE(BM_SortRun, int32_t, false)->Apply(RunArguments);
+BENCHMARK_TEMPLATE(BM_SortRun, int32_t, true)->Apply(RunArguments);
+BENCHMARK_TEMPLATE(BM_SortRun, int64_t, false)->Apply(RunArguments);
+BENCHMARK_TEMPLATE(BM_SortRun, int64_t, true)->Apply(RunArguments);
+BENCHMARK_TEMPLATE(BM_WriteToCell, int32_t)->Apply(TapeArguments);
+BENCHMARK_TEMPLATE(BM_MoveLeftScan, int32_t)->Apply(TapeArguments);
+BENCHMARK_TEMPLATE(BM_MoveLeftScan, int64_t)->Apply(TapeArguments);
+
+BENCHMARK_MAIN();
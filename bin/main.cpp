@@ -1,3 +1,5 @@
+#include <chrono>
+#include <fstream>
 #include <iostream>
 
 #include "lib/config_reader/simple_yaml_reader.hpp"
@@ -24,14 +26,102 @@ int main(int argc, char *argv[]) {
   const std::filesystem::path path_in = config["path_in"].AsPath();
   const std::filesystem::path path_out = config["path_out"].AsPath();
 
-  tape::Tape<int32_t> tape_in{
-      path_in, size, memory, delay_for_read, delay_for_write, delay_for_shift};
-  tape::Tape<int32_t> tape_out{path_out, delay_for_read, delay_for_write,
-                               delay_for_shift};
+  tape::TapeContext context{
+      tape::Delays{delay_for_read, delay_for_write, delay_for_shift}};
+  if (config.Contains("delay_mode") &&
+      tape::ParseDelayMode(config["delay_mode"].AsString()) ==
+          tape::DelayMode::kVirtual) {
+    context.clock_ = std::make_shared<tape::DeviceClock>();
+  }
+  if (config.Contains("memory_budget") && config["memory_budget"].AsBool()) {
+    context.budget_ = std::make_shared<tape::MemoryBudget>(memory);
+  }
+#ifdef TAPE_SORTER_STATS
+  if (config.Contains("stats_json")) {
+    context.counters_ = std::make_shared<tape::OperationCounters>();
+  }
+#endif
 
-  tape::TapeSorter sorter{tape_in, tape_out};
+  tape::Tape<int32_t> tape_in{path_in, size, memory, context};
+  tape::Tape<int32_t> tape_out{path_out, context};
 
-  sorter.Sort();
+  tape::SorterOptions options;
+  if (config.Contains("run_generation")) {
+    options.run_generation_ =
+        tape::ParseRunGeneration(config["run_generation"].AsString());
+  }
+  if (config.Contains("threads")) {
+    options.threads_ = config["threads"].AsInt32();
+  }
+  if (config.Contains("prefetch")) {
+    options.prefetch_ = config["prefetch"].AsBool();
+  }
+  if (config.Contains("mapped_merge")) {
+    options.mapped_merge_ = config["mapped_merge"].AsBool();
+  }
+  if (config.Contains("merge_tapes")) {
+    options.merge_tapes_ = config["merge_tapes"].AsInt32();
+  }
+  if (config.Contains("read_backward")) {
+    options.read_backward_ = config["read_backward"].AsBool();
+  }
+  if (config.Contains("aggregation")) {
+    options.aggregation_ =
+        tape::ParseAggregation(config["aggregation"].AsString());
+  }
+
+  tape::TapeSorter sorter{tape_in, tape_out, options};
+
+  const tape::SortCost estimate =
+      tape::CostModel{context.delays_}.Estimate(sorter.MakePlan());
+  for (const tape::PhaseCost &phase : estimate.phases_) {
+    std::cout << "Estimated " << phase.name_ << ": " << phase.time_.count()
+              << " ms (reads: " << phase.reads_
+              << ", writes: " << phase.writes_
+              << ", shifts: " << phase.shifts_ << ")\n";
+  }
+  std::cout << "Estimated device time: " << estimate.time_.count() << " ms\n";
+
+  const auto start = std::chrono::steady_clock::now();
+  const tape::SortStats stats = sorter.Sort();
+  const auto wall_time = std::chrono::steady_clock::now() - start;
+
+  std::cout << "Runs: " << sorter.GetRunsNumber()
+            << ", merge fan-in: " << sorter.GetFanIn()
+            << ", merge passes: " << sorter.GetMergePassesNumber() << '\n';
+  if (context.clock_) {
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    const tape::DeviceClock &clock = *context.clock_;
+    std::cout << "Device time: "
+              << duration_cast<milliseconds>(clock.GetElapsed()).count()
+              << " ms (reading: "
+              << duration_cast<milliseconds>(
+                     clock.GetElapsed(tape::DeviceOperation::kReading))
+                     .count()
+              << " ms, writing: "
+              << duration_cast<milliseconds>(
+                     clock.GetElapsed(tape::DeviceOperation::kWriting))
+                     .count()
+              << " ms, shift: "
+              << duration_cast<milliseconds>(
+                     clock.GetElapsed(tape::DeviceOperation::kShift))
+                     .count()
+              << " ms)\n";
+  }
+  std::cout << "Wall time: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(wall_time)
+                   .count()
+            << " ms\n";
+  if (context.budget_) {
+    std::cout << "Peak memory: " << context.budget_->GetPeak() << " of "
+              << context.budget_->GetLimit() << " bytes\n";
+  }
+
+  if (config.Contains("stats_json")) {
+    std::ofstream stats_out(config["stats_json"].AsPath());
+    stats_out << stats.ToJson();
+  }
 
   return 0;
 }
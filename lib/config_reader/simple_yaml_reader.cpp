@@ -30,6 +30,10 @@ SimpleYamlReader::Value SimpleYamlReader::operator[](
   return fields_[field_name];
 }
 
+bool SimpleYamlReader::Contains(const std::string &field_name) const {
+  return fields_.contains(field_name);
+}
+
 SimpleYamlReader::Value::Value(std::string value) : value_(std::move(value)) {}
 
 [[nodiscard]] std::chrono::milliseconds
@@ -64,4 +68,8 @@ SimpleYamlReader::Value::AsMilliseconds() const {
 [[nodiscard]] double SimpleYamlReader::Value::AsDouble() const {
   return std::stod(value_);
 }
+
+[[nodiscard]] bool SimpleYamlReader::Value::AsBool() const {
+  return value_ == "true" || value_ == "1";
+}
 }  // namespace config_reader
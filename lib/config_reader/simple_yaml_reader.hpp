@@ -28,6 +28,7 @@ class SimpleYamlReader {
     [[nodiscard]] long long AsLongLong() const;
     [[nodiscard]] long AsLong() const;
     [[nodiscard]] double AsDouble() const;
+    [[nodiscard]] bool AsBool() const;
 
    private:
     std::string value_;
@@ -35,6 +36,8 @@ class SimpleYamlReader {
 
   Value operator[](const std::string &field_name);
 
+  [[nodiscard]] bool Contains(const std::string &field_name) const;
+
  private:
   std::filesystem::path path_;
   std::unordered_map<std::string, Value> fields_;
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+
+#include "../record/record.hpp"
+#include "../sorter/sorter_options.hpp"
+#include "../writer/tape_writer.hpp"
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Check if two elements of a sorted sequence are combined by the
+/// aggregation: they are if their keys are equivalent. Both comparisons are
+/// made, so the sequence may be sorted in either direction.
+///
+/// \tparam Less strict weak ordering of elements.
+/// \tparam T type of elements.
+/// \param aggregation aggregation mode.
+/// \param lhs first element.
+/// \param rhs second element.
+/// \return true if the elements are combined else false.
+////////////////////////////////////////////////////////////////////////////////
+template <typename Less, typename T>
+[[nodiscard]] bool IsCombined(Aggregation aggregation, const T &lhs,
+                              const T &rhs) {
+  Less less;
+  return aggregation != Aggregation::kNone && !less(lhs, rhs) &&
+         !less(rhs, lhs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Combine an element into the first element of its group: counted
+/// records add up their payloads, other elements are dropped.
+///
+/// \tparam T type of elements.
+/// \param aggregation aggregation mode.
+/// \param group first element of the group.
+/// \param element element combined into the group.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void Combine(Aggregation aggregation, T &group, const T &element) {
+  if constexpr (kIsCountRecord<T>) {
+    if (aggregation == Aggregation::kCount) {
+      group.payload_ += element.payload_;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Combine the groups of equivalent elements of a sorted run in place,
+/// as std::unique does.
+///
+/// \tparam Less strict weak ordering of elements.
+/// \tparam T type of elements.
+/// \param aggregation aggregation mode.
+/// \param elements elements of the run.
+/// \return number of elements left at the beginning of the run.
+////////////////////////////////////////////////////////////////////////////////
+template <typename Less, typename T>
+[[nodiscard]] std::size_t CombineRun(Aggregation aggregation,
+                                     std::span<T> elements) {
+  if (aggregation == Aggregation::kNone || elements.empty()) {
+    return elements.size();
+  }
+  std::size_t last = 0;
+  for (std::size_t i = 1; i < elements.size(); i++) {
+    if (IsCombined<Less>(aggregation, elements[last], elements[i])) {
+      Combine(aggregation, elements[last], elements[i]);
+    } else {
+      elements[++last] = elements[i];
+    }
+  }
+  return last + 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Writer of a sorted run that combines the groups of equivalent
+/// elements before they reach the tape writer. The last group is held back,
+/// since the next elements may still join it, until the run is flushed.
+///
+/// \tparam TapeType type of elements in tapes.
+/// \tparam Less strict weak ordering of elements.
+////////////////////////////////////////////////////////////////////////////////
+template <typename TapeType, typename Less>
+class AggregatingWriter {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief AggregatingWriter constructor.
+  ///
+  /// \param writer writer of the combined elements.
+  /// \param aggregation aggregation mode.
+  //////////////////////////////////////////////////////////////////////////////
+  AggregatingWriter(TapeWriter<TapeType> &writer, Aggregation aggregation);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Write the next element of the run.
+  ///
+  /// \param element element.
+  //////////////////////////////////////////////////////////////////////////////
+  void Write(const TapeType &element);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Write the next elements of the run. The stretches of elements
+  /// that are not combined are passed to the tape writer at once.
+  ///
+  /// \param elements elements.
+  //////////////////////////////////////////////////////////////////////////////
+  void WriteChunk(std::span<const TapeType> elements);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Write the last group at the end of the run. The next elements
+  /// start a new group.
+  //////////////////////////////////////////////////////////////////////////////
+  void Flush();
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Writer of the combined elements.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeWriter<TapeType> *writer_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Aggregation mode.
+  //////////////////////////////////////////////////////////////////////////////
+  Aggregation aggregation_ = Aggregation::kNone;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Combined last group, not written yet.
+  //////////////////////////////////////////////////////////////////////////////
+  std::optional<TapeType> group_;
+};
+
+template <typename TapeType, typename Less>
+AggregatingWriter<TapeType, Less>::AggregatingWriter(
+    TapeWriter<TapeType> &writer, Aggregation aggregation)
+    : writer_(&writer), aggregation_(aggregation) {}
+
+template <typename TapeType, typename Less>
+void AggregatingWriter<TapeType, Less>::Write(const TapeType &element) {
+  if (aggregation_ == Aggregation::kNone) {
+    writer_->Write(element);
+    return;
+  }
+  if (group_ && IsCombined<Less>(aggregation_, *group_, element)) {
+    Combine(aggregation_, *group_, element);
+    return;
+  }
+  Flush();
+  group_ = element;
+}
+
+template <typename TapeType, typename Less>
+void AggregatingWriter<TapeType, Less>::WriteChunk(
+    std::span<const TapeType> elements) {
+  if (aggregation_ == Aggregation::kNone) {
+    writer_->WriteChunk(elements);
+    return;
+  }
+  std::size_t i = 0;
+  for (; i < elements.size() && group_ &&
+         IsCombined<Less>(aggregation_, *group_, elements[i]);
+       i++) {
+    Combine(aggregation_, *group_, elements[i]);
+  }
+  if (i == elements.size()) {
+    return;
+  }
+  Flush();
+
+  // First element of the stretch not written yet.
+  std::size_t begin = i;
+  while (i < elements.size()) {
+    std::size_t first = i;
+    TapeType group = elements[first];
+    for (i++; i < elements.size() &&
+              IsCombined<Less>(aggregation_, group, elements[i]);
+         i++) {
+      Combine(aggregation_, group, elements[i]);
+    }
+    if (i == elements.size()) {
+      writer_->WriteChunk(elements.subspan(begin, first - begin));
+      group_ = group;
+    } else if (i - first > 1) {
+      writer_->WriteChunk(elements.subspan(begin, first - begin));
+      writer_->Write(group);
+      begin = i;
+    }
+  }
+}
+
+template <typename TapeType, typename Less>
+void AggregatingWriter<TapeType, Less>::Flush() {
+  if (group_) {
+    writer_->Write(*group_);
+    group_.reset();
+  }
+}
+}  // namespace tape
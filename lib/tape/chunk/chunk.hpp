@@ -1,8 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <span>
 #include <vector>
 
-#include "../delays/delays.hpp"
+#include "../delays/tape_context.hpp"
+#include "../format/tape_format.hpp"
+#include "../memory_budget/budget_allocator.hpp"
 
 namespace tape {
 
@@ -25,11 +29,13 @@ class Chunk {
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Chunk constructor.
   ///
-  /// \param delays delays in reading, putting, moving.
+  /// \param context delays in reading, putting, moving and the memory budget.
   /// \param chunk_number chunk number/position/id.
-  /// \param size number of elements of the chunk.
+  /// \param size number of elements of the largest chunk of the tape.
+  /// \param format format of the tape file the chunk is read from.
   //////////////////////////////////////////////////////////////////////////////
-  Chunk(Delays delays, ChunksNumber chunk_number, ChunkSize size);
+  Chunk(TapeContext context, ChunksNumber chunk_number, ChunkSize size,
+        TapeFormat format = TapeFormat::kText);
 
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Read new chunk from a file.
@@ -57,7 +63,7 @@ class Chunk {
   void PrintChunk(std::fstream& to);
 
   //////////////////////////////////////////////////////////////////////////////
-  /// \brief Clear chunk without changing delays.
+  /// \brief Clear chunk and free its memory without changing delays.
   //////////////////////////////////////////////////////////////////////////////
   void Destroy();
 
@@ -83,11 +89,28 @@ class Chunk {
   [[nodiscard]] TapeType GetCurrentElement() const;
 
   //////////////////////////////////////////////////////////////////////////////
-  /// \brief Get all elements in the chunk.
+  /// \brief Get all elements in the chunk without copying them.
+  ///
+  /// \return view of the elements, valid until the chunk is read again.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::span<const TapeType> GetChunkElements() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Take the elements out of the chunk without copying them. The
+  /// chunk has no elements until a new chunk is read into it.
   ///
   /// \return vector of elements.
   //////////////////////////////////////////////////////////////////////////////
-  [[nodiscard]] std::vector<TapeType> GetChunkElements() const;
+  [[nodiscard]] BudgetVector<TapeType> TakeElements();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Give back a buffer taken by TakeElements. The next chunk is read
+  /// into it without allocating memory. A buffer charged to another memory
+  /// budget is dropped.
+  ///
+  /// \param elements buffer of elements.
+  //////////////////////////////////////////////////////////////////////////////
+  void ReturnElements(BudgetVector<TapeType> &&elements);
 
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Checking for the element to the left of the magnetic head. It does
@@ -148,6 +171,40 @@ class Chunk {
   //////////////////////////////////////////////////////////////////////////////
   void MoveToRightEdge();
 
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Move the tape until the magnetic head points to the given
+  /// position of the chunk.
+  ///
+  /// \param pos position in the chunk.
+  //////////////////////////////////////////////////////////////////////////////
+  void MoveToPos(ChunkSize pos);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Put the magnetic head on the given position at once. The caller
+  /// is charged for the movement.
+  ///
+  /// \param pos position in the chunk.
+  //////////////////////////////////////////////////////////////////////////////
+  void JumpToPos(ChunkSize pos);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Copy the elements starting from the position of the magnetic head
+  /// without moving it. The caller is charged for the reading.
+  ///
+  /// \param to buffer for the elements.
+  /// \return number of copied elements.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunkSize CopyElementsFromPos(std::span<TapeType> to) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Replace the elements starting from the position of the magnetic
+  /// head without moving it. The caller is charged for the putting.
+  ///
+  /// \param from new elements.
+  /// \return number of replaced elements.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunkSize PutElementsFromPos(std::span<const TapeType> from);
+
  private:
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Checking that the current position is the leftmost in the chunk.
@@ -164,9 +221,9 @@ class Chunk {
   [[nodiscard]] bool IsRightEdge() const;
 
   //////////////////////////////////////////////////////////////////////////////
-  /// \brief Delays in reading, putting, moving.
+  /// \brief Delays in reading, putting, moving and the memory budget.
   //////////////////////////////////////////////////////////////////////////////
-  Delays delays_{};
+  TapeContext context_{};
 
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Chunk number/position/id.
@@ -178,20 +235,38 @@ class Chunk {
   //////////////////////////////////////////////////////////////////////////////
   ChunkSize size_{};
 
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of elements of the largest chunk, the buffer is allocated
+  /// for.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunkSize max_size_{};
+
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Position in the chunk from cell indicated by the magnetic head.
   //////////////////////////////////////////////////////////////////////////////
   ChunkSize pos_{};
 
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Format of the tape file the chunk is read from.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeFormat format_ = TapeFormat::kText;
+
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Array of chunk elements.
   //////////////////////////////////////////////////////////////////////////////
-  std::vector<TapeType> elements_{};
+  BudgetVector<TapeType> elements_{};
 };
 
 template <typename TapeType>
-Chunk<TapeType>::Chunk(Delays delays, ChunksNumber chunk_number, ChunkSize size)
-    : delays_(delays), chunk_number_(chunk_number), size_(size), pos_(0) {}
+Chunk<TapeType>::Chunk(TapeContext context, ChunksNumber chunk_number,
+                       ChunkSize size, TapeFormat format)
+    : context_(context),
+      chunk_number_(chunk_number),
+      size_(size),
+      max_size_(size),
+      pos_(0),
+      format_(format),
+      elements_(BudgetAllocator<TapeType>(context.budget_)) {}
 
 template <typename TapeType>
 void Chunk<TapeType>::ReadNewChunk(std::fstream& from,
@@ -200,27 +275,33 @@ void Chunk<TapeType>::ReadNewChunk(std::fstream& from,
   size_ = new_size;
   pos_ = new_chunk_number >= chunk_number_ ? size_ - 1 : 0;
   chunk_number_ = new_chunk_number;
-  elements_.clear();
-  elements_.resize(size_);
-  for (TapeType& elem : elements_) {
-    std::this_thread::sleep_for(delays_.delay_for_shift_);
-    std::this_thread::sleep_for(delays_.delay_for_reading_);
-    from >> elem;
+  // The buffer is allocated for the largest chunk whichever chunk is read
+  // first, so the chunks of a tape are read into it without growing it past
+  // the planned memory.
+  if (elements_.capacity() < size_) {
+    elements_.clear();
+    elements_.shrink_to_fit();
+    elements_.reserve(std::max(size_, max_size_));
   }
+  elements_.resize(size_);
+  context_.WaitForShift(size_);
+  context_.WaitForReading(size_);
+  context_.Count(TapeCounter::kChunkLoads);
+  context_.Count(TapeCounter::kBytesRead, size_ * sizeof(TapeType));
+  ReadElements(from, std::span<TapeType>(elements_), format_);
 }
 
 template <typename TapeType>
 void Chunk<TapeType>::PutElementInArrayByPos(const TapeType& elem,
                                              ChunkSize pos) {
-  std::this_thread::sleep_for(delays_.delay_for_writing_);
+  context_.WaitForWriting();
   elements_[pos] = elem;
 }
 
 template <typename TapeType>
 void Chunk<TapeType>::PrintChunk(std::fstream& to) {
-  for (TapeType elem : elements_) {
-    to << elem << ' ';
-  }
+  context_.Count(TapeCounter::kBytesWritten, size_ * sizeof(TapeType));
+  WriteElements(to, std::span<const TapeType>(elements_), format_);
 }
 
 template <typename TapeType>
@@ -229,6 +310,7 @@ void Chunk<TapeType>::Destroy() {
   size_ = 0;
   pos_ = 0;
   elements_.clear();
+  elements_.shrink_to_fit();
 }
 
 template <typename TapeType>
@@ -243,15 +325,27 @@ ChunksNumber Chunk<TapeType>::GetChunkNumber() const {
 
 template <typename TapeType>
 TapeType Chunk<TapeType>::GetCurrentElement() const {
-  std::this_thread::sleep_for(delays_.delay_for_reading_);
+  context_.WaitForReading();
   return elements_[pos_];
 }
 
 template <typename TapeType>
-std::vector<TapeType> Chunk<TapeType>::GetChunkElements() const {
+std::span<const TapeType> Chunk<TapeType>::GetChunkElements() const {
   return elements_;
 }
 
+template <typename TapeType>
+BudgetVector<TapeType> Chunk<TapeType>::TakeElements() {
+  return std::move(elements_);
+}
+
+template <typename TapeType>
+void Chunk<TapeType>::ReturnElements(BudgetVector<TapeType> &&elements) {
+  if (elements.get_allocator() == elements_.get_allocator()) {
+    elements_ = std::move(elements);
+  }
+}
+
 template <typename TapeType>
 bool Chunk<TapeType>::IsPossibleTakeLeftElement() const {
   return !(chunk_number_ == 0 && pos_ == 0);
@@ -274,7 +368,7 @@ bool Chunk<TapeType>::MoveRightPos() {
   if (!IsPossibleTakeLeftElement() || IsLeftEdge()) {
     return false;
   }
-  std::this_thread::sleep_for(delays_.delay_for_shift_);
+  context_.WaitForShift();
   pos_--;
 
   return true;
@@ -285,7 +379,7 @@ bool Chunk<TapeType>::MoveLeftPos() {
   if (IsRightEdge()) {
     return false;
   }
-  std::this_thread::sleep_for(delays_.delay_for_shift_);
+  context_.WaitForShift();
   pos_++;
 
   return true;
@@ -305,6 +399,33 @@ void Chunk<TapeType>::MoveToRightEdge() {
   }
 }
 
+template <typename TapeType>
+void Chunk<TapeType>::MoveToPos(ChunkSize pos) {
+  while (pos_ > pos && MoveRightPos()) {
+  }
+  while (pos_ < pos && MoveLeftPos()) {
+  }
+}
+
+template <typename TapeType>
+void Chunk<TapeType>::JumpToPos(ChunkSize pos) {
+  pos_ = std::min<ChunkSize>(pos, size_ - 1);
+}
+
+template <typename TapeType>
+ChunkSize Chunk<TapeType>::CopyElementsFromPos(std::span<TapeType> to) const {
+  ChunkSize count = std::min<std::size_t>(to.size(), elements_.size() - pos_);
+  std::copy_n(elements_.begin() + pos_, count, to.begin());
+  return count;
+}
+
+template <typename TapeType>
+ChunkSize Chunk<TapeType>::PutElementsFromPos(std::span<const TapeType> from) {
+  ChunkSize count = std::min<std::size_t>(from.size(), elements_.size() - pos_);
+  std::copy_n(from.begin(), count, elements_.begin() + pos_);
+  return count;
+}
+
 template <typename TapeType>
 bool Chunk<TapeType>::IsLeftEdge() const {
   return pos_ == 0;
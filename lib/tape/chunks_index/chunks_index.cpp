@@ -0,0 +1,29 @@
+#include "chunks_index.hpp"
+
+namespace tape {
+void ChunksIndex::Record(ChunksNumber chunk_number, std::streampos offset) {
+  if (chunk_number < offsets_.size()) {
+    offsets_[chunk_number] = offset;
+  } else if (chunk_number == offsets_.size()) {
+    offsets_.push_back(offset);
+  }
+}
+
+bool ChunksIndex::Contains(ChunksNumber chunk_number) const {
+  return chunk_number < offsets_.size();
+}
+
+std::streampos ChunksIndex::Get(ChunksNumber chunk_number) const {
+  return offsets_[chunk_number];
+}
+
+ChunksNumber ChunksIndex::GetKnownChunksNumber() const {
+  return static_cast<ChunksNumber>(offsets_.size());
+}
+
+void ChunksIndex::Truncate(ChunksNumber chunks_number) {
+  if (chunks_number < offsets_.size()) {
+    offsets_.resize(chunks_number);
+  }
+}
+}  // namespace tape
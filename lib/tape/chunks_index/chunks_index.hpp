@@ -0,0 +1,66 @@
+#pragma once
+
+#include <ios>
+#include <vector>
+
+#include "../chunk/chunk.hpp"
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Byte offsets of chunks inside the file of a text tape. Offsets are
+/// known for a prefix of chunks: they are recorded while the tape is scanned
+/// from left to right, so any known chunk is reached with one seek.
+////////////////////////////////////////////////////////////////////////////////
+class ChunksIndex {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief ChunksIndex default constructor.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunksIndex() = default;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Record the offset of a chunk. Only the chunk next to the known
+  /// ones can be added.
+  ///
+  /// \param chunk_number number of the chunk.
+  /// \param offset offset of the first element of the chunk in the file.
+  //////////////////////////////////////////////////////////////////////////////
+  void Record(ChunksNumber chunk_number, std::streampos offset);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Check that the offset of a chunk is known.
+  ///
+  /// \param chunk_number number of the chunk.
+  /// \return true if the offset is known else false.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] bool Contains(ChunksNumber chunk_number) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the offset of a chunk.
+  ///
+  /// \param chunk_number number of the chunk. Its offset must be known.
+  /// \return offset of the first element of the chunk in the file.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::streampos Get(ChunksNumber chunk_number) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of chunks with known offsets.
+  ///
+  /// \return number of chunks with known offsets.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetKnownChunksNumber() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Forget the offsets of all chunks starting from the given one.
+  ///
+  /// \param chunks_number number of chunks whose offsets are kept.
+  //////////////////////////////////////////////////////////////////////////////
+  void Truncate(ChunksNumber chunks_number);
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Offsets of the known chunks.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<std::streampos> offsets_{};
+};
+}  // namespace tape
@@ -0,0 +1,187 @@
+#include "cost_model.hpp"
+
+#include <algorithm>
+
+#include "../polyphase/polyphase_merge.hpp"
+
+namespace tape {
+CostModel::CostModel(const Delays &delays) : delays_(delays) {}
+
+SortCost CostModel::Estimate(const SortPlan &plan) const {
+  SortCost cost;
+  if (!plan.elements_number_) {
+    return cost;
+  }
+  cost.phases_.push_back(EstimateSplit(plan));
+
+  if (plan.split_access_ != SplitAccess::kSingleChunk && plan.merge_tapes_) {
+    EstimatePolyphaseMerge(plan, cost);
+  } else if (plan.split_access_ != SplitAccess::kSingleChunk) {
+    ChunksNumber runs_number = plan.runs_number_;
+    uint64_t run_size = (plan.elements_number_ - 1) / runs_number + 1;
+    ChunksNumber pass = 1;
+    while (runs_number > plan.fan_in_) {
+      cost.phases_.push_back(EstimateMergePass(plan, pass++, runs_number,
+                                               run_size, plan.pass_fan_in_,
+                                               plan.pass_read_block_size_));
+      runs_number = (runs_number - 1) / plan.pass_fan_in_ + 1;
+      run_size = std::min<uint64_t>(run_size * plan.pass_fan_in_,
+                                    plan.elements_number_);
+    }
+    cost.phases_.push_back(EstimateMergePass(plan, pass, runs_number,
+                                             run_size, plan.fan_in_,
+                                             plan.read_block_size_));
+  }
+
+  for (const PhaseCost &phase : cost.phases_) {
+    cost.time_ += phase.time_;
+  }
+  return cost;
+}
+
+PhaseCost CostModel::EstimateSplit(const SortPlan &plan) const {
+  uint64_t elements_number = plan.elements_number_;
+  ChunkSize chunk_size = std::max<ChunkSize>(plan.chunk_size_, 1);
+
+  PhaseCost phase{"split"};
+  switch (plan.split_access_) {
+    case SplitAccess::kSingleChunk:
+    case SplitAccess::kChunks:
+      AddChunksReading(phase, elements_number, chunk_size);
+      break;
+    case SplitAccess::kCells:
+      AddCellsReading(phase, elements_number, chunk_size);
+      break;
+  }
+  phase.writes_ = elements_number;
+  phase.shifts_ += elements_number;
+  if (plan.merge_tapes_ && !plan.read_backward_ &&
+      plan.split_access_ != SplitAccess::kSingleChunk) {
+    // The physical tapes are rewound.
+    phase.shifts_ += elements_number;
+  }
+  SetTime(phase);
+  return phase;
+}
+
+void CostModel::EstimatePolyphaseMerge(const SortPlan &plan,
+                                       SortCost &cost) const {
+  PolyphaseMerge schedule(plan.merge_tapes_, plan.read_backward_);
+  uint64_t run_size = (plan.elements_number_ - 1) / plan.runs_number_ + 1;
+  auto runs_number =
+      static_cast<ChunksNumber>((plan.elements_number_ - 1) / run_size + 1);
+  std::vector<bool> descending_runs;
+  if (plan.read_backward_) {
+    descending_runs =
+        PolyphaseMerge::PlanDescendingRuns(plan.merge_tapes_, runs_number);
+  }
+  uint64_t left = plan.elements_number_;
+  for (ChunksNumber i = 0; i < runs_number; i++) {
+    uint64_t size = std::min(run_size, left);
+    schedule.AddRun(static_cast<TapeSize>(size),
+                    plan.read_backward_ && descending_runs[i]);
+    left -= size;
+  }
+
+  ChunkSize chunk_size = std::max<ChunkSize>(plan.read_block_size_, 1);
+  ChunksNumber pass = 1;
+  while (schedule.GetPhasesNumber()) {
+    PhaseCost phase{"merge pass " + std::to_string(pass++)};
+    std::vector<uint64_t> tapes_read(schedule.GetTapesNumber());
+    for (ChunksNumber merges = schedule.GetMergesNumber(); merges; merges--) {
+      std::vector<TapeSize> merge = schedule.TakeMerge();
+      for (std::size_t tape = 0; tape < merge.size(); tape++) {
+        tapes_read[tape] += merge[tape];
+      }
+    }
+    for (uint64_t tape_read : tapes_read) {
+      if (tape_read && plan.read_backward_) {
+        // Every chunk is read once, the head stays where the next one starts.
+        phase.reads_ += tape_read;
+        phase.shifts_ += tape_read;
+      } else if (tape_read) {
+        AddCellsReading(phase, tape_read, chunk_size);
+      }
+      if (tape_read) {
+        phase.writes_ += tape_read;
+        phase.shifts_ += tape_read;
+      }
+    }
+    if (schedule.GetPhasesNumber() > 1 && !plan.read_backward_) {
+      phase.shifts_ += schedule.GetTapeSize(schedule.GetOutputTape()) +
+                       schedule.GetTapeSize(schedule.GetEmptiedTape());
+    }
+    schedule.EndPhase();
+    SetTime(phase);
+    cost.phases_.push_back(phase);
+  }
+}
+
+PhaseCost CostModel::EstimateMergePass(const SortPlan &plan, ChunksNumber pass,
+                                       ChunksNumber runs_number,
+                                       uint64_t run_size, ChunksNumber fan_in,
+                                       ChunkSize read_block_size) const {
+  uint64_t elements_number = plan.elements_number_;
+  ChunksNumber groups_number = (runs_number - 1) / fan_in + 1;
+  ChunksNumber last_group_size = runs_number - (groups_number - 1) * fan_in;
+
+  // A group of one run, the last and the shortest one, is moved unread.
+  uint64_t merged_number = elements_number;
+  ChunksNumber merged_runs_number = runs_number;
+  if (last_group_size == 1 && groups_number > 1) {
+    merged_number = std::min<uint64_t>(elements_number,
+                                       (runs_number - 1) * run_size);
+    merged_runs_number--;
+  }
+
+  PhaseCost phase{"merge pass " + std::to_string(pass)};
+  if (plan.mapped_merge_) {
+    phase.reads_ = merged_number;
+    phase.shifts_ = merged_number - merged_runs_number;
+  } else {
+    ChunkSize chunk_size = std::clamp<uint64_t>(read_block_size, 1, run_size);
+
+    // Groups of two runs are read chunk by chunk, the others cell by cell.
+    ChunksNumber pairs_number =
+        (fan_in == 2 ? groups_number - 1 : 0) + (last_group_size == 2 ? 1 : 0);
+    uint64_t left = merged_number;
+    for (ChunksNumber i = 0; i < 2 * pairs_number && left; i++) {
+      uint64_t size = std::min(run_size, left);
+      AddChunksReading(phase, size, chunk_size);
+      left -= size;
+    }
+
+    uint64_t tree_runs_number = merged_runs_number - 2 * pairs_number;
+    uint64_t chunks_number =
+        tree_runs_number * ((run_size - 1) / chunk_size + 1);
+    phase.reads_ += 2 * left;
+    phase.shifts_ += left + 2 * (left - std::min(chunks_number, left));
+  }
+  phase.writes_ = merged_number;
+  phase.shifts_ += merged_number;
+  SetTime(phase);
+  return phase;
+}
+
+void CostModel::AddChunksReading(PhaseCost &phase, uint64_t elements_number,
+                                 ChunkSize chunk_size) {
+  uint64_t chunks_number = (elements_number - 1) / chunk_size + 1;
+  uint64_t first_chunk_size = std::min<uint64_t>(chunk_size, elements_number);
+  phase.reads_ += elements_number;
+  phase.shifts_ += elements_number + (elements_number - first_chunk_size) -
+                   (chunks_number - 1);
+}
+
+void CostModel::AddCellsReading(PhaseCost &phase, uint64_t elements_number,
+                                ChunkSize chunk_size) {
+  uint64_t chunks_number = (elements_number - 1) / chunk_size + 1;
+  phase.reads_ += 2 * elements_number;
+  phase.shifts_ += elements_number + 2 * (elements_number - chunks_number);
+}
+
+void CostModel::SetTime(PhaseCost &phase) const {
+  phase.time_ = delays_.delay_for_reading_ * phase.reads_ +
+                delays_.delay_for_writing_ * phase.writes_ +
+                delays_.delay_for_shift_ * phase.shifts_;
+}
+}  // namespace tape
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../chunk/chunk.hpp"
+#include "../delays/delays.hpp"
+#include "../tape_interface.hpp"
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief How the input tape is accessed while it is split into runs.
+////////////////////////////////////////////////////////////////////////////////
+enum class SplitAccess : uint8_t {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief The tape is one chunk sorted straight into the output tape.
+  //////////////////////////////////////////////////////////////////////////////
+  kSingleChunk,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief The tape is read chunk by chunk.
+  //////////////////////////////////////////////////////////////////////////////
+  kChunks,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief The tape is read cell by cell.
+  //////////////////////////////////////////////////////////////////////////////
+  kCells
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Plan of a sort: what TapeSorter is going to do with the tape.
+////////////////////////////////////////////////////////////////////////////////
+struct SortPlan {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of elements of the input tape.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeSize elements_number_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Size of a chunk of the input tape.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunkSize chunk_size_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Access to the input tape while it is split.
+  //////////////////////////////////////////////////////////////////////////////
+  SplitAccess split_access_ = SplitAccess::kChunks;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Expected number of runs after splitting.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunksNumber runs_number_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of runs merged at once by the final merge. Merge passes
+  /// are made while there are more runs.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunksNumber fan_in_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Size of the buffer a run is read with by the final merge.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunkSize read_block_size_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of runs merged at once by the other merge passes.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunksNumber pass_fan_in_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Size of the buffer a run is read with by the other merge passes.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunkSize pass_read_block_size_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Runs are read through memory mappings while merged.
+  //////////////////////////////////////////////////////////////////////////////
+  bool mapped_merge_ = false;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of physical tapes of the polyphase merge. Zero if every
+  /// run is merged from a temporary tape of its own.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunksNumber merge_tapes_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief The physical tapes are read backward by chunks without rewinds.
+  //////////////////////////////////////////////////////////////////////////////
+  bool read_backward_ = false;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Numbers of device operations of a phase of the sort and their time.
+////////////////////////////////////////////////////////////////////////////////
+struct PhaseCost {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Name of the phase.
+  //////////////////////////////////////////////////////////////////////////////
+  std::string name_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of read elements.
+  //////////////////////////////////////////////////////////////////////////////
+  uint64_t reads_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of put elements.
+  //////////////////////////////////////////////////////////////////////////////
+  uint64_t writes_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of moves by one position.
+  //////////////////////////////////////////////////////////////////////////////
+  uint64_t shifts_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Device time of the phase.
+  //////////////////////////////////////////////////////////////////////////////
+  std::chrono::milliseconds time_{};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Estimate of the device time of a sort.
+////////////////////////////////////////////////////////////////////////////////
+struct SortCost {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Costs of the split and of every merge pass.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<PhaseCost> phases_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Device time of the whole sort.
+  //////////////////////////////////////////////////////////////////////////////
+  std::chrono::milliseconds time_{};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Model of the device time of a sort. Operations are counted the way
+/// Tape charges them: reading a chunk costs a read and a shift per element,
+/// rewinding a chunk read from the right costs a shift per element, a cell
+/// read costs a read and the following move a shift, and a written element
+/// costs a write and a shift.
+////////////////////////////////////////////////////////////////////////////////
+class CostModel {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief CostModel constructor.
+  ///
+  /// \param delays delays in reading, putting, moving.
+  //////////////////////////////////////////////////////////////////////////////
+  explicit CostModel(const Delays &delays);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Estimate the device time of a sort.
+  ///
+  /// \param plan plan of the sort.
+  /// \return costs of the phases and the total time.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] SortCost Estimate(const SortPlan &plan) const;
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Estimate the cost of splitting the input tape.
+  ///
+  /// \param plan plan of the sort.
+  /// \return cost of the split.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] PhaseCost EstimateSplit(const SortPlan &plan) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Estimate the costs of the phases of a polyphase merge. The runs
+  /// are read cell by cell; at the end of a phase its output tape and the
+  /// emptied input tape are rewound. Tapes read backward are read by chunks
+  /// and never rewound.
+  ///
+  /// \param plan plan of the sort.
+  /// \param cost costs of the sort the phases are added to.
+  //////////////////////////////////////////////////////////////////////////////
+  void EstimatePolyphaseMerge(const SortPlan &plan, SortCost &cost) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Estimate the cost of one merge pass.
+  ///
+  /// \param plan plan of the sort.
+  /// \param pass number of the merge pass.
+  /// \param runs_number number of runs before the pass.
+  /// \param run_size size of every run but the last, shorter one.
+  /// \param fan_in number of runs merged at once.
+  /// \param read_block_size size of the buffer a run is read with.
+  /// \return cost of the merge pass.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] PhaseCost EstimateMergePass(const SortPlan &plan,
+                                            ChunksNumber pass,
+                                            ChunksNumber runs_number,
+                                            uint64_t run_size,
+                                            ChunksNumber fan_in,
+                                            ChunkSize read_block_size) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Add the operations of reading a tape chunk by chunk: every chunk
+  /// is read, and every chunk but the first is rewound to its left edge.
+  ///
+  /// \param phase phase of the sort.
+  /// \param elements_number number of elements of the tape.
+  /// \param chunk_size size of a chunk.
+  //////////////////////////////////////////////////////////////////////////////
+  static void AddChunksReading(PhaseCost &phase, uint64_t elements_number,
+                               ChunkSize chunk_size);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Add the operations of reading a tape cell by cell: every chunk is
+  /// read and rewound, then every cell is read and passed.
+  ///
+  /// \param phase phase of the sort.
+  /// \param elements_number number of elements of the tape.
+  /// \param chunk_size size of a chunk.
+  //////////////////////////////////////////////////////////////////////////////
+  static void AddCellsReading(PhaseCost &phase, uint64_t elements_number,
+                              ChunkSize chunk_size);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Set the time of a phase from its operations.
+  ///
+  /// \param phase phase of the sort.
+  //////////////////////////////////////////////////////////////////////////////
+  void SetTime(PhaseCost &phase) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Delays in reading, putting and shifting.
+  //////////////////////////////////////////////////////////////////////////////
+  Delays delays_{};
+};
+}  // namespace tape
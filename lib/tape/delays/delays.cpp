@@ -1,10 +1,42 @@
 #include "delays.hpp"
 
+#include <stdexcept>
+#include <thread>
+
 namespace tape {
+DelayMode ParseDelayMode(const std::string &name) {
+  if (name == "sleep") {
+    return DelayMode::kSleep;
+  }
+  if (name == "virtual") {
+    return DelayMode::kVirtual;
+  }
+  throw std::invalid_argument("Unknown delay mode: " + name);
+}
+
 Delays::Delays(std::chrono::milliseconds delay_for_read,
                std::chrono::milliseconds delay_for_write,
                std::chrono::milliseconds delay_for_shift)
     : delay_for_reading_(delay_for_read),
       delay_for_writing_(delay_for_write),
       delay_for_shift_(delay_for_shift) {}
+
+void Delays::WaitForReading(uint64_t count) const {
+  Wait(delay_for_reading_ * count);
+}
+
+void Delays::WaitForWriting(uint64_t count) const {
+  Wait(delay_for_writing_ * count);
+}
+
+void Delays::WaitForShift(uint64_t count) const {
+  Wait(delay_for_shift_ * count);
+}
+
+void Delays::Wait(std::chrono::milliseconds delay) const {
+  if (delay == std::chrono::milliseconds::zero()) {
+    return;
+  }
+  std::this_thread::sleep_for(delay);
+}
 }  // namespace tape
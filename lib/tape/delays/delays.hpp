@@ -1,9 +1,33 @@
 #pragma once
 
 #include <chrono>
-#include <future>
+#include <cstdint>
+#include <string>
 
 namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Way of accounting delays.
+////////////////////////////////////////////////////////////////////////////////
+enum class DelayMode : uint8_t {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Delays are slept.
+  //////////////////////////////////////////////////////////////////////////////
+  kSleep,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Delays are added to a DeviceClock.
+  //////////////////////////////////////////////////////////////////////////////
+  kVirtual
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Parse the delay mode from its config name: "sleep" or "virtual".
+/// Throws std::invalid_argument for other names.
+///
+/// \param name name of the mode.
+/// \return delay mode.
+////////////////////////////////////////////////////////////////////////////////
+[[nodiscard]] DelayMode ParseDelayMode(const std::string &name);
+
 ////////////////////////////////////////////////////////////////////////////////
 /// \brief Delays for processes.
 ////////////////////////////////////////////////////////////////////////////////
@@ -24,6 +48,27 @@ struct Delays {
          std::chrono::milliseconds delay_for_writing,
          std::chrono::milliseconds delay_for_shift);
 
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Wait for reading elements.
+  ///
+  /// \param count number of elements.
+  //////////////////////////////////////////////////////////////////////////////
+  void WaitForReading(uint64_t count = 1) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Wait for putting elements.
+  ///
+  /// \param count number of elements.
+  //////////////////////////////////////////////////////////////////////////////
+  void WaitForWriting(uint64_t count = 1) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Wait for moving the tape.
+  ///
+  /// \param count number of positions.
+  //////////////////////////////////////////////////////////////////////////////
+  void WaitForShift(uint64_t count = 1) const;
+
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Delay in reading the element indicated by the magnetic head.
   //////////////////////////////////////////////////////////////////////////////
@@ -37,5 +82,13 @@ struct Delays {
   /// \brief Delay for moving the tape by one position.
   //////////////////////////////////////////////////////////////////////////////
   std::chrono::milliseconds delay_for_shift_{};
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Sleep for the delay.
+  ///
+  /// \param delay total delay.
+  //////////////////////////////////////////////////////////////////////////////
+  void Wait(std::chrono::milliseconds delay) const;
 };
 }  // namespace tape
@@ -0,0 +1,31 @@
+#include "device_clock.hpp"
+
+namespace tape {
+void DeviceClock::Advance(DeviceOperation operation,
+                          std::chrono::nanoseconds duration) {
+  elapsed_[static_cast<std::size_t>(operation)].fetch_add(
+      duration.count(), std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds DeviceClock::GetElapsed() const {
+  std::chrono::nanoseconds elapsed{};
+  for (const std::atomic<int64_t> &operation_elapsed : elapsed_) {
+    elapsed += std::chrono::nanoseconds(
+        operation_elapsed.load(std::memory_order_relaxed));
+  }
+  return elapsed;
+}
+
+std::chrono::nanoseconds DeviceClock::GetElapsed(
+    DeviceOperation operation) const {
+  return std::chrono::nanoseconds(
+      elapsed_[static_cast<std::size_t>(operation)].load(
+          std::memory_order_relaxed));
+}
+
+void DeviceClock::Reset() {
+  for (std::atomic<int64_t> &operation_elapsed : elapsed_) {
+    operation_elapsed.store(0, std::memory_order_relaxed);
+  }
+}
+}  // namespace tape
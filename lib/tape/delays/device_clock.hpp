@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Operation of the tape device.
+////////////////////////////////////////////////////////////////////////////////
+enum class DeviceOperation : uint8_t { kReading, kWriting, kShift };
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Simulated clock of the tape device. Delays are added to it instead
+/// of being slept, so the time the device would spend is known without
+/// waiting for it. The clock can be shared by tapes used from several
+/// threads.
+////////////////////////////////////////////////////////////////////////////////
+class DeviceClock {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief DeviceClock default constructor. The clock starts at zero.
+  //////////////////////////////////////////////////////////////////////////////
+  DeviceClock() = default;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Add the time of an operation to the clock.
+  ///
+  /// \param operation operation of the device.
+  /// \param duration time of the operation.
+  //////////////////////////////////////////////////////////////////////////////
+  void Advance(DeviceOperation operation, std::chrono::nanoseconds duration);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the total time of all operations.
+  ///
+  /// \return device time.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::chrono::nanoseconds GetElapsed() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the total time of one kind of operations.
+  ///
+  /// \param operation operation of the device.
+  /// \return device time of the operations.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::chrono::nanoseconds GetElapsed(
+      DeviceOperation operation) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Set the clock to zero.
+  //////////////////////////////////////////////////////////////////////////////
+  void Reset();
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of kinds of operations.
+  //////////////////////////////////////////////////////////////////////////////
+  static constexpr std::size_t kOperationsNumber = 3;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Time of every kind of operations in nanoseconds.
+  //////////////////////////////////////////////////////////////////////////////
+  std::atomic<int64_t> elapsed_[kOperationsNumber]{};
+};
+}  // namespace tape
@@ -0,0 +1,34 @@
+#include "tape_context.hpp"
+
+namespace tape {
+TapeContext::TapeContext(const Delays &delays) : delays_(delays) {}
+
+void TapeContext::WaitForReading(uint64_t count) const {
+  Count(TapeCounter::kCellsRead, count);
+  if (clock_) {
+    clock_->Advance(DeviceOperation::kReading,
+                    delays_.delay_for_reading_ * count);
+    return;
+  }
+  delays_.WaitForReading(count);
+}
+
+void TapeContext::WaitForWriting(uint64_t count) const {
+  Count(TapeCounter::kCellsWritten, count);
+  if (clock_) {
+    clock_->Advance(DeviceOperation::kWriting,
+                    delays_.delay_for_writing_ * count);
+    return;
+  }
+  delays_.WaitForWriting(count);
+}
+
+void TapeContext::WaitForShift(uint64_t count) const {
+  Count(TapeCounter::kShifts, count);
+  if (clock_) {
+    clock_->Advance(DeviceOperation::kShift, delays_.delay_for_shift_ * count);
+    return;
+  }
+  delays_.WaitForShift(count);
+}
+}  // namespace tape
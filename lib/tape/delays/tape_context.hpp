@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "../memory_budget/memory_budget.hpp"
+#include "../stats/operation_counters.hpp"
+#include "delays.hpp"
+#include "device_clock.hpp"
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Everything tapes, writers and sorters share besides their files:
+/// the delays of the device, the clock the delays are added to, the budget
+/// their buffers take memory from and the counters of their operations.
+/// Copies of the context share the clock, the budget and the counters.
+////////////////////////////////////////////////////////////////////////////////
+struct TapeContext {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief TapeContext default constructor. No delays, nothing attached.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeContext() = default;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief TapeContext constructor by delays, nothing attached. Not
+  /// explicit, so delays can be passed wherever a context is expected.
+  ///
+  /// \param delays delays in reading, putting, moving.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeContext(const Delays &delays);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Count reading elements and wait for it: add the delay to the
+  /// clock if it is attached, sleep otherwise.
+  ///
+  /// \param count number of elements.
+  //////////////////////////////////////////////////////////////////////////////
+  void WaitForReading(uint64_t count = 1) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Count putting elements and wait for it.
+  ///
+  /// \param count number of elements.
+  //////////////////////////////////////////////////////////////////////////////
+  void WaitForWriting(uint64_t count = 1) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Count moving the tape and wait for it.
+  ///
+  /// \param count number of positions.
+  //////////////////////////////////////////////////////////////////////////////
+  void WaitForShift(uint64_t count = 1) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Count operations if the counters are attached. Without
+  /// TAPE_SORTER_STATS it does nothing.
+  ///
+  /// \param counter counted operation.
+  /// \param count number of operations.
+  //////////////////////////////////////////////////////////////////////////////
+  void Count(TapeCounter counter, uint64_t count = 1) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Delays in reading, putting and shifting.
+  //////////////////////////////////////////////////////////////////////////////
+  Delays delays_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Budget the buffers of tapes, writers and sorters take their
+  /// memory from.
+  //////////////////////////////////////////////////////////////////////////////
+  std::shared_ptr<MemoryBudget> budget_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Clock the delays are added to instead of being slept.
+  //////////////////////////////////////////////////////////////////////////////
+  std::shared_ptr<DeviceClock> clock_{};
+#ifdef TAPE_SORTER_STATS
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Counters the operations are added to.
+  //////////////////////////////////////////////////////////////////////////////
+  std::shared_ptr<OperationCounters> counters_{};
+#endif
+};
+
+inline void TapeContext::Count([[maybe_unused]] TapeCounter counter,
+                               [[maybe_unused]] uint64_t count) const {
+#ifdef TAPE_SORTER_STATS
+  if (counters_) {
+    counters_->Add(counter, count);
+  }
+#endif
+}
+}  // namespace tape
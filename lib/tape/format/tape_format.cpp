@@ -0,0 +1,63 @@
+#include "tape_format.hpp"
+
+#include <stdexcept>
+
+namespace tape {
+namespace {
+template <typename T>
+void WriteField(std::ostream &to, T value) {
+  to.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+T ReadField(std::istream &from) {
+  T value{};
+  from.read(reinterpret_cast<char *>(&value), sizeof(T));
+  return value;
+}
+}  // namespace
+
+BinaryTapeHeader BinaryTapeHeader::Read(std::istream &from) {
+  BinaryTapeHeader header;
+  header.magic_ = ReadField<uint32_t>(from);
+  header.version_ = ReadField<uint16_t>(from);
+  header.element_kind_ = static_cast<ElementKind>(ReadField<uint8_t>(from));
+  header.element_width_ = ReadField<uint8_t>(from);
+  header.endianness_ = ReadField<uint8_t>(from) == 0 ? std::endian::little
+                                                     : std::endian::big;
+  from.ignore(7);
+  header.elements_number_ = ReadField<uint64_t>(from);
+
+  if (!from || header.magic_ != kMagic) {
+    throw std::runtime_error("File is not a binary tape");
+  }
+  if (header.version_ != kVersion) {
+    throw std::runtime_error("Unsupported binary tape version");
+  }
+  return header;
+}
+
+void BinaryTapeHeader::Write(std::ostream &to) const {
+  WriteField<uint32_t>(to, magic_);
+  WriteField<uint16_t>(to, version_);
+  WriteField<uint8_t>(to, static_cast<uint8_t>(element_kind_));
+  WriteField<uint8_t>(to, element_width_);
+  WriteField<uint8_t>(to, endianness_ == std::endian::little ? 0 : 1);
+  for (int i = 0; i < 7; i++) {
+    WriteField<uint8_t>(to, 0);
+  }
+  WriteField<uint64_t>(to, elements_number_);
+}
+
+void BinaryTapeHeader::UpdateElementsNumber(std::ostream &to,
+                                            uint64_t elements_number) {
+  std::streampos position = to.tellp();
+  to.seekp(kElementsNumberOffset);
+  WriteField<uint64_t>(to, elements_number);
+  to.seekp(position);
+}
+
+std::ios::openmode OpenMode(TapeFormat format, std::ios::openmode mode) {
+  return format == TapeFormat::kBinary ? mode | std::ios::binary : mode;
+}
+}  // namespace tape
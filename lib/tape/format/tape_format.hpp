@@ -0,0 +1,259 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief On-disk format of a tape.
+////////////////////////////////////////////////////////////////////////////////
+enum class TapeFormat : uint8_t {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Whitespace-separated elements.
+  //////////////////////////////////////////////////////////////////////////////
+  kText,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief BinaryTapeHeader followed by fixed-width elements.
+  //////////////////////////////////////////////////////////////////////////////
+  kBinary
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Kind of elements stored in a binary tape.
+////////////////////////////////////////////////////////////////////////////////
+enum class ElementKind : uint8_t {
+  kSignedInteger,
+  kUnsignedInteger,
+  kFloatingPoint,
+  kTrivial
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Header at the beginning of a binary tape file. It is stored as
+/// kSize bytes: magic (4), version (2), element kind (1), element width (1),
+/// endianness (1), reserved (7), number of elements (8).
+////////////////////////////////////////////////////////////////////////////////
+struct BinaryTapeHeader {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Create a header for elements of type T.
+  ///
+  /// \tparam T type of elements in the tape.
+  /// \param elements_number number of elements in the tape.
+  /// \return header.
+  //////////////////////////////////////////////////////////////////////////////
+  template <typename T>
+  [[nodiscard]] static BinaryTapeHeader For(uint64_t elements_number);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Check that the tape stores elements of type T in the native byte
+  /// order. Throws std::runtime_error otherwise.
+  ///
+  /// \tparam T type of elements in the tape.
+  //////////////////////////////////////////////////////////////////////////////
+  template <typename T>
+  void CheckFor() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Read a header from the beginning of a stream. Throws
+  /// std::runtime_error if the magic or the version does not match.
+  ///
+  /// \param from stream from where the header is read.
+  /// \return header.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] static BinaryTapeHeader Read(std::istream &from);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Write the header to the beginning of a stream.
+  ///
+  /// \param to stream where the header is written.
+  //////////////////////////////////////////////////////////////////////////////
+  void Write(std::ostream &to) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Rewrite the number of elements in the header of a stream.
+  ///
+  /// \param to stream where the header is located.
+  /// \param elements_number new number of elements.
+  //////////////////////////////////////////////////////////////////////////////
+  static void UpdateElementsNumber(std::ostream &to, uint64_t elements_number);
+
+  static constexpr uint32_t kMagic = 0x45504154;  // "TAPE"
+  static constexpr uint16_t kVersion = 1;
+  static constexpr std::streamoff kSize = 24;
+  static constexpr std::streamoff kElementsNumberOffset = 16;
+
+  uint32_t magic_ = kMagic;
+  uint16_t version_ = kVersion;
+  ElementKind element_kind_ = ElementKind::kTrivial;
+  uint8_t element_width_{};
+  std::endian endianness_ = std::endian::native;
+  uint64_t elements_number_{};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Get the open mode of a file stream for the tape format.
+///
+/// \param format tape format.
+/// \param mode open mode without the binary flag.
+/// \return open mode.
+////////////////////////////////////////////////////////////////////////////////
+[[nodiscard]] std::ios::openmode OpenMode(TapeFormat format,
+                                          std::ios::openmode mode);
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Get the offset of a cell in the file of a binary tape.
+///
+/// \tparam T type of elements in the tape.
+/// \param cell cell number.
+/// \return offset in bytes.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+[[nodiscard]] constexpr std::streamoff BinaryCellOffset(uint64_t cell) {
+  return BinaryTapeHeader::kSize +
+         static_cast<std::streamoff>(cell * sizeof(T));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Read elements from the current position of a stream.
+///
+/// \param from stream from where the elements are read.
+/// \param elements elements to be read.
+/// \param format tape format.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void ReadElements(std::istream &from, std::span<T> elements,
+                  TapeFormat format);
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Write elements to the current position of a stream.
+///
+/// \param to stream where the elements are written.
+/// \param elements elements to be written.
+/// \param format tape format.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void WriteElements(std::ostream &to, std::span<const T> elements,
+                   TapeFormat format);
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Convert a text tape into a binary tape.
+///
+/// \param from path to the text tape.
+/// \param to path to the binary tape.
+/// \return number of converted elements.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+uint64_t ConvertTextToBinary(const std::filesystem::path &from,
+                             const std::filesystem::path &to);
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Convert a binary tape into a text tape.
+///
+/// \param from path to the binary tape.
+/// \param to path to the text tape.
+/// \return number of converted elements.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+uint64_t ConvertBinaryToText(const std::filesystem::path &from,
+                             const std::filesystem::path &to);
+
+template <typename T>
+BinaryTapeHeader BinaryTapeHeader::For(uint64_t elements_number) {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "binary tapes store trivially copyable elements only");
+  static_assert(sizeof(T) <= UINT8_MAX, "element is too wide");
+
+  BinaryTapeHeader header;
+  if constexpr (std::is_floating_point_v<T>) {
+    header.element_kind_ = ElementKind::kFloatingPoint;
+  } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+    header.element_kind_ = ElementKind::kSignedInteger;
+  } else if constexpr (std::is_integral_v<T>) {
+    header.element_kind_ = ElementKind::kUnsignedInteger;
+  }
+  header.element_width_ = static_cast<uint8_t>(sizeof(T));
+  header.elements_number_ = elements_number;
+  return header;
+}
+
+template <typename T>
+void BinaryTapeHeader::CheckFor() const {
+  BinaryTapeHeader expected = For<T>(elements_number_);
+  if (element_kind_ != expected.element_kind_ ||
+      element_width_ != expected.element_width_) {
+    throw std::runtime_error("Binary tape has another element type");
+  }
+  if (endianness_ != std::endian::native) {
+    throw std::runtime_error("Binary tape has another byte order");
+  }
+}
+
+template <typename T>
+void ReadElements(std::istream &from, std::span<T> elements,
+                  TapeFormat format) {
+  if (format == TapeFormat::kBinary) {
+    from.read(reinterpret_cast<char *>(elements.data()),
+              static_cast<std::streamsize>(elements.size_bytes()));
+    return;
+  }
+  for (T &element : elements) {
+    from >> element;
+  }
+}
+
+template <typename T>
+void WriteElements(std::ostream &to, std::span<const T> elements,
+                   TapeFormat format) {
+  if (format == TapeFormat::kBinary) {
+    to.write(reinterpret_cast<const char *>(elements.data()),
+             static_cast<std::streamsize>(elements.size_bytes()));
+    return;
+  }
+  for (const T &element : elements) {
+    to << element << ' ';
+  }
+}
+
+template <typename T>
+uint64_t ConvertTextToBinary(const std::filesystem::path &from,
+                             const std::filesystem::path &to) {
+  std::ifstream text_from(from);
+  std::ofstream binary_to(to, std::ios::out | std::ios::binary);
+
+  BinaryTapeHeader::For<T>(0).Write(binary_to);
+  uint64_t elements_number = 0;
+  T element;
+  while (text_from >> element) {
+    WriteElements<T>(binary_to, std::span<const T>(&element, 1),
+                     TapeFormat::kBinary);
+    elements_number++;
+  }
+  BinaryTapeHeader::UpdateElementsNumber(binary_to, elements_number);
+
+  return elements_number;
+}
+
+template <typename T>
+uint64_t ConvertBinaryToText(const std::filesystem::path &from,
+                             const std::filesystem::path &to) {
+  std::ifstream binary_from(from, std::ios::in | std::ios::binary);
+  std::ofstream text_to(to);
+
+  BinaryTapeHeader header = BinaryTapeHeader::Read(binary_from);
+  header.CheckFor<T>();
+  T element;
+  for (uint64_t i = 0; i < header.elements_number_; i++) {
+    ReadElements<T>(binary_from, std::span<T>(&element, 1),
+                    TapeFormat::kBinary);
+    WriteElements<T>(text_to, std::span<const T>(&element, 1),
+                     TapeFormat::kText);
+  }
+
+  return header.elements_number_;
+}
+}  // namespace tape
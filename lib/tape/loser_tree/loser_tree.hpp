@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Tournament tree of losers for merging k sorted sequences. Every
+/// internal node keeps the leaf that lost the match in it, so replacing the
+/// key of the winner costs one comparison per tree level. Equal keys are won
+/// by the leaf with the smaller number, so the merge is stable.
+///
+/// \tparam Key type of keys.
+/// \tparam Compare strict weak ordering of keys.
+////////////////////////////////////////////////////////////////////////////////
+template <typename Key, typename Compare = std::less<Key>>
+class LoserTree {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief LoserTree constructor. All leaves are exhausted until Set is
+  /// called for them.
+  ///
+  /// \param leaves_number number of merged sequences.
+  /// \param compare strict weak ordering of keys.
+  //////////////////////////////////////////////////////////////////////////////
+  explicit LoserTree(std::size_t leaves_number, Compare compare = Compare{});
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Set the first key of a sequence. Must be called before Build.
+  ///
+  /// \param leaf number of the sequence.
+  /// \param key first key of the sequence.
+  //////////////////////////////////////////////////////////////////////////////
+  void Set(std::size_t leaf, const Key &key);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Play the tournament between the first keys of all sequences.
+  //////////////////////////////////////////////////////////////////////////////
+  void Build();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Check that all sequences are exhausted.
+  ///
+  /// \return true if all sequences are exhausted else false.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] bool Empty() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of sequences that are not exhausted.
+  ///
+  /// \return number of active sequences.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::size_t GetActiveNumber() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of the sequence with the smallest key.
+  ///
+  /// \return number of the winning sequence.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::size_t Top() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the smallest key.
+  ///
+  /// \return key of the winning sequence.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] const Key &TopKey() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Replace the key of the winning sequence by its next key.
+  ///
+  /// \param key next key of the winning sequence.
+  //////////////////////////////////////////////////////////////////////////////
+  void Replace(const Key &key);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Mark the winning sequence as exhausted.
+  //////////////////////////////////////////////////////////////////////////////
+  void Pop();
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Check that the leaf a wins the match against the leaf b.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] bool Wins(std::size_t a, std::size_t b) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Play the matches in the subtree of the node.
+  ///
+  /// \return winner of the subtree.
+  //////////////////////////////////////////////////////////////////////////////
+  std::size_t Play(std::size_t node);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Replay the matches on the path from the winning leaf to the root.
+  //////////////////////////////////////////////////////////////////////////////
+  void Replay();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Current keys of the sequences.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<Key> keys_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Flags of exhausted sequences.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<bool> exhausted_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Losers of internal nodes 1..k-1. Leaf i is the node k + i.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<std::size_t> losers_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Winner of the whole tournament.
+  //////////////////////////////////////////////////////////////////////////////
+  std::size_t winner_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of sequences that are not exhausted.
+  //////////////////////////////////////////////////////////////////////////////
+  std::size_t active_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Ordering of keys.
+  //////////////////////////////////////////////////////////////////////////////
+  Compare compare_;
+};
+
+template <typename Key, typename Compare>
+LoserTree<Key, Compare>::LoserTree(std::size_t leaves_number, Compare compare)
+    : keys_(leaves_number),
+      exhausted_(leaves_number, true),
+      losers_(leaves_number),
+      compare_(compare) {}
+
+template <typename Key, typename Compare>
+void LoserTree<Key, Compare>::Set(std::size_t leaf, const Key &key) {
+  keys_[leaf] = key;
+  if (exhausted_[leaf]) {
+    exhausted_[leaf] = false;
+    active_++;
+  }
+}
+
+template <typename Key, typename Compare>
+void LoserTree<Key, Compare>::Build() {
+  winner_ = keys_.empty() ? 0 : Play(1);
+}
+
+template <typename Key, typename Compare>
+bool LoserTree<Key, Compare>::Empty() const {
+  return keys_.empty() || exhausted_[winner_];
+}
+
+template <typename Key, typename Compare>
+std::size_t LoserTree<Key, Compare>::GetActiveNumber() const {
+  return active_;
+}
+
+template <typename Key, typename Compare>
+std::size_t LoserTree<Key, Compare>::Top() const {
+  return winner_;
+}
+
+template <typename Key, typename Compare>
+const Key &LoserTree<Key, Compare>::TopKey() const {
+  return keys_[winner_];
+}
+
+template <typename Key, typename Compare>
+void LoserTree<Key, Compare>::Replace(const Key &key) {
+  keys_[winner_] = key;
+  Replay();
+}
+
+template <typename Key, typename Compare>
+void LoserTree<Key, Compare>::Pop() {
+  exhausted_[winner_] = true;
+  active_--;
+  Replay();
+}
+
+template <typename Key, typename Compare>
+bool LoserTree<Key, Compare>::Wins(std::size_t a, std::size_t b) const {
+  if (exhausted_[a] || exhausted_[b]) {
+    return !exhausted_[a] || (exhausted_[b] && a < b);
+  }
+  if (compare_(keys_[a], keys_[b])) {
+    return true;
+  }
+  if (compare_(keys_[b], keys_[a])) {
+    return false;
+  }
+  return a < b;
+}
+
+template <typename Key, typename Compare>
+std::size_t LoserTree<Key, Compare>::Play(std::size_t node) {
+  std::size_t leaves_number = keys_.size();
+  if (node >= leaves_number) {
+    return node - leaves_number;
+  }
+  std::size_t left = Play(2 * node);
+  std::size_t right = Play(2 * node + 1);
+  if (Wins(left, right)) {
+    losers_[node] = right;
+    return left;
+  }
+  losers_[node] = left;
+  return right;
+}
+
+template <typename Key, typename Compare>
+void LoserTree<Key, Compare>::Replay() {
+  std::size_t winner = winner_;
+  for (std::size_t node = (winner + keys_.size()) / 2; node >= 1; node /= 2) {
+    if (Wins(losers_[node], winner)) {
+      std::swap(losers_[node], winner);
+    }
+  }
+  winner_ = winner;
+}
+}  // namespace tape
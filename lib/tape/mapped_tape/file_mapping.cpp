@@ -0,0 +1,99 @@
+#include "file_mapping.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace tape {
+FileMapping::FileMapping(const std::filesystem::path &file, bool writable) {
+  int descriptor = open(file.c_str(), writable ? O_RDWR : O_RDONLY);
+  if (descriptor == -1) {
+    throw std::runtime_error("Can not open file " + file.string());
+  }
+  size_ = std::filesystem::file_size(file);
+  if (size_ != 0) {
+    void *data =
+        mmap(nullptr, size_, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+             MAP_SHARED, descriptor, 0);
+    if (data == MAP_FAILED) {
+      close(descriptor);
+      throw std::runtime_error("Can not map file " + file.string());
+    }
+    data_ = static_cast<std::byte *>(data);
+  }
+  close(descriptor);
+}
+
+FileMapping::FileMapping(FileMapping &&other) noexcept {
+  *this = std::move(other);
+}
+
+FileMapping &FileMapping::operator=(FileMapping &&other) noexcept {
+  if (&other != this) {
+    Unmap();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+FileMapping::~FileMapping() {
+  Unmap();
+}
+
+std::byte *FileMapping::GetData() const {
+  return data_;
+}
+
+std::size_t FileMapping::GetSize() const {
+  return size_;
+}
+
+void FileMapping::Advise(std::size_t offset, std::size_t length,
+                         MappingAdvice advice) const {
+  if (data_ == nullptr || offset >= size_) {
+    return;
+  }
+  static const std::size_t page_size = sysconf(_SC_PAGESIZE);
+  std::size_t begin = offset / page_size * page_size;
+  std::size_t end = std::min(offset + length, size_);
+  if (advice == MappingAdvice::kDontNeed) {
+    begin = (offset + page_size - 1) / page_size * page_size;
+    end = end == size_ ? end : end / page_size * page_size;
+    if (begin >= end) {
+      return;
+    }
+  }
+  int native_advice = MADV_NORMAL;
+  switch (advice) {
+    case MappingAdvice::kSequential:
+      native_advice = MADV_SEQUENTIAL;
+      break;
+    case MappingAdvice::kWillNeed:
+      native_advice = MADV_WILLNEED;
+      break;
+    case MappingAdvice::kDontNeed:
+      native_advice = MADV_DONTNEED;
+      break;
+  }
+  madvise(data_ + begin, end - begin, native_advice);
+}
+
+void FileMapping::Sync() const {
+  if (data_ != nullptr) {
+    msync(data_, size_, MS_SYNC);
+  }
+}
+
+void FileMapping::Unmap() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+}
+}  // namespace tape
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Expected access to a range of a file mapping.
+////////////////////////////////////////////////////////////////////////////////
+enum class MappingAdvice : uint8_t {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief The range will be read from left to right.
+  //////////////////////////////////////////////////////////////////////////////
+  kSequential,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief The range will be accessed soon and may be read ahead.
+  //////////////////////////////////////////////////////////////////////////////
+  kWillNeed,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief The range will not be accessed soon and its pages may be freed.
+  //////////////////////////////////////////////////////////////////////////////
+  kDontNeed
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Whole file mapped into memory. Throws std::runtime_error if the
+/// file can not be opened or mapped.
+////////////////////////////////////////////////////////////////////////////////
+class FileMapping {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief FileMapping default constructor. Nothing is mapped.
+  //////////////////////////////////////////////////////////////////////////////
+  FileMapping() = default;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief FileMapping constructor.
+  ///
+  /// \param file path to the file.
+  /// \param writable map the file for writing too.
+  //////////////////////////////////////////////////////////////////////////////
+  FileMapping(const std::filesystem::path &file, bool writable);
+
+  FileMapping(const FileMapping &) = delete;
+  FileMapping &operator=(const FileMapping &) = delete;
+
+  FileMapping(FileMapping &&other) noexcept;
+  FileMapping &operator=(FileMapping &&other) noexcept;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief FileMapping destructor. Unmaps the file.
+  //////////////////////////////////////////////////////////////////////////////
+  ~FileMapping();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the beginning of the mapping.
+  ///
+  /// \return pointer to the first byte of the file.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::byte *GetData() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the size of the mapping.
+  ///
+  /// \return size of the file in bytes.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::size_t GetSize() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Tell the kernel how a range of the mapping will be accessed. The
+  /// range is extended to whole pages, except for kDontNeed which only
+  /// covers the pages lying inside the range.
+  ///
+  /// \param offset offset of the range in bytes.
+  /// \param length length of the range in bytes.
+  /// \param advice expected access.
+  //////////////////////////////////////////////////////////////////////////////
+  void Advise(std::size_t offset, std::size_t length,
+              MappingAdvice advice) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Write the changed pages to the file.
+  //////////////////////////////////////////////////////////////////////////////
+  void Sync() const;
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Unmap the file.
+  //////////////////////////////////////////////////////////////////////////////
+  void Unmap();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Beginning of the mapping.
+  //////////////////////////////////////////////////////////////////////////////
+  std::byte *data_ = nullptr;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Size of the mapping in bytes.
+  //////////////////////////////////////////////////////////////////////////////
+  std::size_t size_{};
+};
+}  // namespace tape
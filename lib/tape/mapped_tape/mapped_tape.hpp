@@ -0,0 +1,435 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include "../delays/tape_context.hpp"
+#include "../format/tape_format.hpp"
+#include "../tape_interface.hpp"
+#include "file_mapping.hpp"
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Binary tape accessed through a memory mapping of its file. Reading,
+/// writing and moving are pointer operations. The mapping is walked in windows
+/// of the size of a chunk: the kernel is asked to read the next window ahead
+/// and to free the previous one.
+///
+/// \tparam TapeType type of elements in the tape.
+////////////////////////////////////////////////////////////////////////////////
+template <typename TapeType>
+class MappedTape : public ITape<TapeType> {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief MappedTape default constructor.
+  //////////////////////////////////////////////////////////////////////////////
+  MappedTape() = default;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief MappedTape constructor. Maps an existing binary tape for reading.
+  ///
+  /// \param file path to the file of the binary tape.
+  /// \param memory_size RAM memory which limits the window.
+  /// \param context delays in reading, putting, moving and the memory budget.
+  //////////////////////////////////////////////////////////////////////////////
+  MappedTape(const std::filesystem::path &file, MemorySize memory_size,
+             const TapeContext &context);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief MappedTape constructor. Creates a binary tape of the given size
+  /// filled with zero elements and maps it for reading and writing.
+  ///
+  /// \param file path to the file of the new binary tape.
+  /// \param size number of elements of the tape.
+  /// \param memory_size RAM memory which limits the window.
+  /// \param context delays in reading, putting, moving and the memory budget.
+  //////////////////////////////////////////////////////////////////////////////
+  MappedTape(const std::filesystem::path &file, TapeSize size,
+             MemorySize memory_size, const TapeContext &context);
+
+  MappedTape(const MappedTape &) = delete;
+  MappedTape &operator=(const MappedTape &) = delete;
+
+  MappedTape(MappedTape &&) noexcept = default;
+  MappedTape &operator=(MappedTape &&) noexcept = default;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief MappedTape destructor.
+  //////////////////////////////////////////////////////////////////////////////
+  ~MappedTape() override = default;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Read and get the element from cell indicated by the magnetic head.
+  ///
+  /// \return element indicated by the magnetic head
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] TapeType ReadCell() override;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Put a new element to the current cell of the tape. Throws
+  /// std::runtime_error if the tape is mapped for reading only.
+  ///
+  /// \param element new element.
+  //////////////////////////////////////////////////////////////////////////////
+  void WriteToCell(const TapeType &element) override;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Move the tape under the magnetic head to the right. After
+  /// execution, the tape element will be one position to the left under the
+  /// magnetic head.
+  ///
+  /// \return true if the move succeeded else false.
+  //////////////////////////////////////////////////////////////////////////////
+  bool MoveRight() override;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Move the tape under the magnetic head to the left. After execution,
+  /// the tape element will be one position to the right under the magnetic
+  /// head.
+  ///
+  /// \return true if the move succeeded else false.
+  //////////////////////////////////////////////////////////////////////////////
+  bool MoveLeft() override;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Read consecutive elements starting from the cell indicated by the
+  /// magnetic head and move the tape to the left by their number. The
+  /// elements are copied from the mapping and the delays are charged at once.
+  /// At the end of the tape nothing is read.
+  ///
+  /// \param elements buffer for the read elements.
+  /// \return number of read elements.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeSize ReadBlock(std::span<TapeType> elements) override;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Put consecutive elements starting from the cell indicated by the
+  /// magnetic head and move the tape to the left by their number. At the end
+  /// of the tape nothing is put. Throws std::runtime_error if the tape is
+  /// mapped for reading only.
+  ///
+  /// \param elements new elements.
+  /// \return number of put elements.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeSize WriteBlock(std::span<const TapeType> elements) override;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Move the tape so that the magnetic head points to the given cell.
+  ///
+  /// \param cell number of the cell.
+  /// \return true if the move succeeded else false.
+  //////////////////////////////////////////////////////////////////////////////
+  bool MoveToCell(TapeSize cell);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Write the changed cells to the file.
+  //////////////////////////////////////////////////////////////////////////////
+  void Flush() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the path to the file where the tape is located.
+  ///
+  /// \return path to the file where the tape is located.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::filesystem::path GetTapeFilePath() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the size of tape.
+  ///
+  /// \return size of tape.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] TapeSize GetSize() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of elements in a window.
+  ///
+  /// \return size of a window.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] TapeSize GetWindowSize() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Set the number of elements in a window.
+  ///
+  /// \param window_size new size of a window.
+  //////////////////////////////////////////////////////////////////////////////
+  void SetWindowSize(TapeSize window_size);
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Map the file and check its header.
+  ///
+  /// \param writable map the file for writing too.
+  //////////////////////////////////////////////////////////////////////////////
+  void Map(bool writable);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Advise the kernel about the windows around the cell when the
+  /// magnetic head enters a new window.
+  ///
+  /// \param cell new cell indicated by the magnetic head.
+  //////////////////////////////////////////////////////////////////////////////
+  void EnterCell(TapeSize cell);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Advise the kernel about consecutive windows.
+  ///
+  /// \param first_window number of the first window.
+  /// \param windows_number number of the windows.
+  /// \param advice expected access.
+  //////////////////////////////////////////////////////////////////////////////
+  void AdviseWindows(TapeSize first_window, TapeSize windows_number,
+                     MappingAdvice advice) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Check that the tape is mapped for writing.
+  //////////////////////////////////////////////////////////////////////////////
+  void CheckWritable() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the elements of the tape in the mapping.
+  ///
+  /// \return pointer to the first element.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] TapeType *GetElements() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Path to the file where the tape is located.
+  //////////////////////////////////////////////////////////////////////////////
+  std::filesystem::path tape_location_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Mapping of the file.
+  //////////////////////////////////////////////////////////////////////////////
+  FileMapping mapping_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of elements of the tape.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeSize size_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of elements in a window.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeSize window_size_ = 1;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Cell indicated by the magnetic head.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeSize pos_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief The tape is mapped for writing too.
+  //////////////////////////////////////////////////////////////////////////////
+  bool writable_ = false;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Delays in reading, putting and shifting, and the memory budget.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeContext context_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief The window takes the same part of memory as a chunk of Tape.
+  //////////////////////////////////////////////////////////////////////////////
+  static const MemorySize kDivider = 16;
+};
+
+template <typename TapeType>
+MappedTape<TapeType>::MappedTape(const std::filesystem::path &file,
+                                 MemorySize memory_size,
+                                 const TapeContext &context)
+    : tape_location_(file),
+      window_size_(std::max<MemorySize>(memory_size / kDivider, 1)),
+      context_(context) {
+  Map(false);
+}
+
+template <typename TapeType>
+MappedTape<TapeType>::MappedTape(const std::filesystem::path &file,
+                                 TapeSize size, MemorySize memory_size,
+                                 const TapeContext &context)
+    : tape_location_(file),
+      window_size_(std::max<MemorySize>(memory_size / kDivider, 1)),
+      context_(context) {
+  std::fstream create(file, OpenMode(TapeFormat::kBinary, std::ios::out));
+  BinaryTapeHeader::For<TapeType>(size).Write(create);
+  create.close();
+  std::filesystem::resize_file(file, BinaryCellOffset<TapeType>(size));
+  Map(true);
+}
+
+template <typename TapeType>
+TapeType MappedTape<TapeType>::ReadCell() {
+  context_.WaitForReading();
+  return GetElements()[pos_];
+}
+
+template <typename TapeType>
+void MappedTape<TapeType>::WriteToCell(const TapeType &element) {
+  CheckWritable();
+  context_.WaitForWriting();
+  GetElements()[pos_] = element;
+}
+
+template <typename TapeType>
+bool MappedTape<TapeType>::MoveRight() {
+  if (pos_ == 0) {
+    return false;
+  }
+  context_.WaitForShift();
+  EnterCell(pos_ - 1);
+  this->at_end_ = false;
+  return true;
+}
+
+template <typename TapeType>
+bool MappedTape<TapeType>::MoveLeft() {
+  if (pos_ + 1 >= size_) {
+    return false;
+  }
+  context_.WaitForShift();
+  EnterCell(pos_ + 1);
+  return true;
+}
+
+template <typename TapeType>
+TapeSize MappedTape<TapeType>::ReadBlock(std::span<TapeType> elements) {
+  if (elements.empty() || !size_ || this->at_end_) {
+    return 0;
+  }
+  TapeSize count = std::min<std::size_t>(elements.size(), size_ - pos_);
+  std::copy_n(GetElements() + pos_, count, elements.begin());
+  TapeSize target = std::min<TapeSize>(pos_ + count, size_ - 1);
+  context_.WaitForReading(count);
+  context_.WaitForShift(target - pos_);
+  this->at_end_ = pos_ + count == size_;
+  EnterCell(target);
+  return count;
+}
+
+template <typename TapeType>
+TapeSize MappedTape<TapeType>::WriteBlock(std::span<const TapeType> elements) {
+  CheckWritable();
+  if (elements.empty() || !size_ || this->at_end_) {
+    return 0;
+  }
+  TapeSize count = std::min<std::size_t>(elements.size(), size_ - pos_);
+  std::copy_n(elements.begin(), count, GetElements() + pos_);
+  TapeSize target = std::min<TapeSize>(pos_ + count, size_ - 1);
+  context_.WaitForWriting(count);
+  context_.WaitForShift(target - pos_);
+  this->at_end_ = pos_ + count == size_;
+  EnterCell(target);
+  return count;
+}
+
+template <typename TapeType>
+bool MappedTape<TapeType>::MoveToCell(TapeSize cell) {
+  if (cell >= size_) {
+    return false;
+  }
+  while (pos_ < cell) {
+    MoveLeft();
+  }
+  while (pos_ > cell) {
+    MoveRight();
+  }
+  this->at_end_ = false;
+  return true;
+}
+
+template <typename TapeType>
+void MappedTape<TapeType>::Flush() const {
+  mapping_.Sync();
+}
+
+template <typename TapeType>
+std::filesystem::path MappedTape<TapeType>::GetTapeFilePath() const {
+  return tape_location_;
+}
+
+template <typename TapeType>
+TapeSize MappedTape<TapeType>::GetSize() const {
+  return size_;
+}
+
+template <typename TapeType>
+TapeSize MappedTape<TapeType>::GetWindowSize() const {
+  return window_size_;
+}
+
+template <typename TapeType>
+void MappedTape<TapeType>::SetWindowSize(TapeSize window_size) {
+  window_size_ = std::max<TapeSize>(window_size, 1);
+  AdviseWindows(pos_ / window_size_ + 1, 1, MappingAdvice::kWillNeed);
+}
+
+template <typename TapeType>
+void MappedTape<TapeType>::Map(bool writable) {
+  std::ifstream header_from(tape_location_,
+                            OpenMode(TapeFormat::kBinary, std::ios::in));
+  BinaryTapeHeader header = BinaryTapeHeader::Read(header_from);
+  header.CheckFor<TapeType>();
+  header_from.close();
+
+  mapping_ = FileMapping(tape_location_, writable);
+  writable_ = writable;
+  size_ = static_cast<TapeSize>(header.elements_number_);
+  if (mapping_.GetSize() <
+      static_cast<std::size_t>(BinaryCellOffset<TapeType>(size_))) {
+    throw std::runtime_error("Tape " + tape_location_.string() +
+                             " is shorter than its header states");
+  }
+  mapping_.Advise(0, mapping_.GetSize(), MappingAdvice::kSequential);
+  AdviseWindows(0, 2, MappingAdvice::kWillNeed);
+}
+
+template <typename TapeType>
+void MappedTape<TapeType>::EnterCell(TapeSize cell) {
+  TapeSize window = cell / window_size_;
+  TapeSize previous_window = pos_ / window_size_;
+  pos_ = cell;
+  if (window == previous_window) {
+    return;
+  }
+  if (window > previous_window) {
+    AdviseWindows(previous_window, window - previous_window,
+                  MappingAdvice::kDontNeed);
+    AdviseWindows(window + 1, 1, MappingAdvice::kWillNeed);
+  } else {
+    AdviseWindows(window + 1, previous_window - window,
+                  MappingAdvice::kDontNeed);
+    if (window > 0) {
+      AdviseWindows(window - 1, 1, MappingAdvice::kWillNeed);
+    }
+  }
+}
+
+template <typename TapeType>
+void MappedTape<TapeType>::AdviseWindows(TapeSize first_window,
+                                         TapeSize windows_number,
+                                         MappingAdvice advice) const {
+  uint64_t first_cell = static_cast<uint64_t>(first_window) * window_size_;
+  if (first_cell >= size_) {
+    return;
+  }
+  mapping_.Advise(BinaryCellOffset<TapeType>(first_cell),
+                  static_cast<std::size_t>(windows_number) * window_size_ *
+                      sizeof(TapeType),
+                  advice);
+}
+
+template <typename TapeType>
+void MappedTape<TapeType>::CheckWritable() const {
+  if (!writable_) {
+    throw std::runtime_error("Tape " + tape_location_.string() +
+                             " is mapped for reading only");
+  }
+}
+
+template <typename TapeType>
+TapeType *MappedTape<TapeType>::GetElements() const {
+  return reinterpret_cast<TapeType *>(mapping_.GetData() +
+                                      BinaryTapeHeader::kSize);
+}
+}  // namespace tape
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "memory_budget.hpp"
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Allocator taking the memory of its allocations from a MemoryBudget.
+/// Without a budget it allocates as std::allocator.
+/// \tparam T type of allocated objects.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+class BudgetAllocator {
+ public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief BudgetAllocator default constructor. The allocator has no budget.
+  //////////////////////////////////////////////////////////////////////////////
+  BudgetAllocator() = default;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief BudgetAllocator constructor.
+  ///
+  /// \param budget budget of the allocations, may be empty.
+  //////////////////////////////////////////////////////////////////////////////
+  explicit BudgetAllocator(std::shared_ptr<MemoryBudget> budget);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief BudgetAllocator converting constructor.
+  ///
+  /// \param other allocator of other objects with the same budget.
+  //////////////////////////////////////////////////////////////////////////////
+  template <typename U>
+  BudgetAllocator(const BudgetAllocator<U> &other);  // NOLINT
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Allocate memory for objects. Throws BudgetExceeded if the memory
+  /// does not fit in the budget.
+  ///
+  /// \param n number of objects.
+  /// \return pointer to the memory.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] T *allocate(std::size_t n);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Free memory of objects and give it back to the budget.
+  ///
+  /// \param pointer pointer to the memory.
+  /// \param n number of objects.
+  //////////////////////////////////////////////////////////////////////////////
+  void deallocate(T *pointer, std::size_t n) noexcept;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the budget of the allocations.
+  ///
+  /// \return budget, may be empty.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] const std::shared_ptr<MemoryBudget> &GetBudget() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Allocators are equal if they take memory from the same budget.
+  ///
+  /// \param other other allocator.
+  /// \return true if the budgets are the same else false.
+  //////////////////////////////////////////////////////////////////////////////
+  template <typename U>
+  bool operator==(const BudgetAllocator<U> &other) const;
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Budget of the allocations.
+  //////////////////////////////////////////////////////////////////////////////
+  std::shared_ptr<MemoryBudget> budget_{};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Vector taking its memory from a MemoryBudget.
+/// \tparam T type of elements.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+using BudgetVector = std::vector<T, BudgetAllocator<T>>;
+
+template <typename T>
+BudgetAllocator<T>::BudgetAllocator(std::shared_ptr<MemoryBudget> budget)
+    : budget_(std::move(budget)) {}
+
+template <typename T>
+template <typename U>
+BudgetAllocator<T>::BudgetAllocator(const BudgetAllocator<U> &other)
+    : budget_(other.GetBudget()) {}
+
+template <typename T>
+T *BudgetAllocator<T>::allocate(std::size_t n) {
+  if (budget_) {
+    budget_->Acquire(n * sizeof(T));
+  }
+  try {
+    return std::allocator<T>().allocate(n);
+  } catch (...) {
+    if (budget_) {
+      budget_->Release(n * sizeof(T));
+    }
+    throw;
+  }
+}
+
+template <typename T>
+void BudgetAllocator<T>::deallocate(T *pointer, std::size_t n) noexcept {
+  std::allocator<T>().deallocate(pointer, n);
+  if (budget_) {
+    budget_->Release(n * sizeof(T));
+  }
+}
+
+template <typename T>
+const std::shared_ptr<MemoryBudget> &BudgetAllocator<T>::GetBudget() const {
+  return budget_;
+}
+
+template <typename T>
+template <typename U>
+bool BudgetAllocator<T>::operator==(const BudgetAllocator<U> &other) const {
+  return budget_ == other.GetBudget();
+}
+}  // namespace tape
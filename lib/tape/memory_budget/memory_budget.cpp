@@ -0,0 +1,56 @@
+#include "memory_budget.hpp"
+
+#include <string>
+
+namespace tape {
+MemoryBudget::MemoryBudget(std::size_t limit) : limit_(limit) {}
+
+void MemoryBudget::Acquire(std::size_t bytes) {
+  if (!TryAcquire(bytes)) {
+    throw BudgetExceeded("Memory budget exceeded: " + std::to_string(bytes) +
+                         " bytes requested, " + std::to_string(GetUsed()) +
+                         " of " + std::to_string(limit_) + " bytes used");
+  }
+}
+
+bool MemoryBudget::TryAcquire(std::size_t bytes) {
+  std::size_t used = used_.load(std::memory_order_relaxed);
+  do {
+    if (bytes > limit_ - used) {
+      return false;
+    }
+  } while (!used_.compare_exchange_weak(used, used + bytes,
+                                        std::memory_order_relaxed));
+
+  std::size_t peak = peak_.load(std::memory_order_relaxed);
+  while (used + bytes > peak &&
+         !peak_.compare_exchange_weak(peak, used + bytes,
+                                      std::memory_order_relaxed)) {
+  }
+  return true;
+}
+
+void MemoryBudget::Release(std::size_t bytes) {
+  used_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+std::size_t MemoryBudget::GetLimit() const {
+  return limit_;
+}
+
+std::size_t MemoryBudget::GetUsed() const {
+  return used_.load(std::memory_order_relaxed);
+}
+
+std::size_t MemoryBudget::GetAvailable() const {
+  return limit_ - GetUsed();
+}
+
+std::size_t MemoryBudget::GetPeak() const {
+  return peak_.load(std::memory_order_relaxed);
+}
+
+void MemoryBudget::ResetPeak() {
+  peak_.store(GetUsed(), std::memory_order_relaxed);
+}
+}  // namespace tape
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Error thrown when an allocation does not fit in a MemoryBudget.
+////////////////////////////////////////////////////////////////////////////////
+class BudgetExceeded : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Limit of the RAM memory taken by buffers of tapes and sorters. The
+/// budget can be shared by sorts running side by side in several threads.
+////////////////////////////////////////////////////////////////////////////////
+class MemoryBudget {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief MemoryBudget constructor.
+  ///
+  /// \param limit limit in bytes.
+  //////////////////////////////////////////////////////////////////////////////
+  explicit MemoryBudget(std::size_t limit);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Take memory from the budget. Throws BudgetExceeded if the memory
+  /// does not fit.
+  ///
+  /// \param bytes size of the memory.
+  //////////////////////////////////////////////////////////////////////////////
+  void Acquire(std::size_t bytes);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Take memory from the budget if it fits.
+  ///
+  /// \param bytes size of the memory.
+  /// \return true if the memory was taken else false.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] bool TryAcquire(std::size_t bytes);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Give memory back to the budget.
+  ///
+  /// \param bytes size of the memory.
+  //////////////////////////////////////////////////////////////////////////////
+  void Release(std::size_t bytes);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the limit of the budget.
+  ///
+  /// \return limit in bytes.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::size_t GetLimit() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the memory taken now.
+  ///
+  /// \return size in bytes.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::size_t GetUsed() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the memory that can still be taken.
+  ///
+  /// \return size in bytes.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::size_t GetAvailable() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the largest memory taken at once.
+  ///
+  /// \return size in bytes.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::size_t GetPeak() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Set the peak to the memory taken now.
+  //////////////////////////////////////////////////////////////////////////////
+  void ResetPeak();
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Limit in bytes.
+  //////////////////////////////////////////////////////////////////////////////
+  const std::size_t limit_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Memory taken now in bytes.
+  //////////////////////////////////////////////////////////////////////////////
+  std::atomic<std::size_t> used_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Largest memory taken at once in bytes.
+  //////////////////////////////////////////////////////////////////////////////
+  std::atomic<std::size_t> peak_{};
+};
+}  // namespace tape
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+#include "../sorter/sorter_options.hpp"
+#include "../tape_interface.hpp"
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Planner of the RAM memory of a sort. The split and the merge run one
+/// after the other, so each of them may use the whole memory; the planner
+/// divides it into the buffers of the chosen algorithm. A share of the memory
+/// is kept for the rest of the sorter.
+/// \tparam TapeType type of elements in tapes.
+////////////////////////////////////////////////////////////////////////////////
+template <typename TapeType>
+class MemoryPlanner {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief MemoryPlanner default constructor.
+  //////////////////////////////////////////////////////////////////////////////
+  MemoryPlanner() = default;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief MemoryPlanner constructor.
+  ///
+  /// \param memory RAM memory in bytes.
+  /// \param options sorting options.
+  /// \param sort_scratch runs are sorted with a scratch buffer of half a run,
+  /// as stable sorts are.
+  //////////////////////////////////////////////////////////////////////////////
+  MemoryPlanner(MemorySize memory, const SorterOptions &options,
+                bool sort_scratch = false);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the chunk size of the input tape while it is split. A chunk
+  /// sorted in place takes the whole memory, or two thirds of it beside the
+  /// scratch buffer of a stable sort; otherwise the chunk is a buffer of the
+  /// input tape beside the buffers of the algorithm.
+  ///
+  /// \return size of a chunk.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunkSize GetSplitChunkSize() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of elements of the heap of replacement selection.
+  ///
+  /// \tparam HeapElement type of elements of the heap.
+  /// \return size of the heap.
+  //////////////////////////////////////////////////////////////////////////////
+  template <typename HeapElement = std::pair<ChunksNumber, TapeType>>
+  [[nodiscard]] ChunkSize GetHeapSize() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of threads sorting the blocks of the parallel
+  /// split: one per thread of the options, as long as each of the blocks
+  /// being read, sorted and written keeps kMinSplitBlockSize elements.
+  ///
+  /// \return number of sorting threads.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetSplitThreadsNumber() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the size of a block sorted by the parallel split. The blocks
+  /// being read, sorted and written, and the scratch buffers of the blocks
+  /// being sorted stably, share the memory left by the input tape.
+  ///
+  /// \return size of a block.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunkSize GetSplitBlockSize() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of merges run at once by a merge pass: one per
+  /// thread, as long as each of them fits the smallest fan-in with buffers of
+  /// kMinMergeBlockSize elements.
+  ///
+  /// \return number of merges sharing the memory.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetMergesNumber() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of runs merged at once. Every merged run and the
+  /// output get a buffer of at least kMinMergeBlockSize elements, and the tree
+  /// of losers takes one more buffer.
+  ///
+  /// \param runs_number number of runs.
+  /// \param merges_number number of merges sharing the memory.
+  /// \return merge fan-in.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetFanIn(ChunksNumber runs_number,
+                                      ChunksNumber merges_number = 1) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the size of the buffer of each merged run and of the output.
+  ///
+  /// \param fan_in merge fan-in.
+  /// \param merges_number number of merges sharing the memory.
+  /// \return size of a merge buffer.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunkSize GetMergeBlockSize(
+      ChunksNumber fan_in, ChunksNumber merges_number = 1) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief The smallest buffer of a merged run.
+  //////////////////////////////////////////////////////////////////////////////
+  static constexpr ChunkSize kMinMergeBlockSize = 4;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief The smallest block sorted by the parallel split.
+  //////////////////////////////////////////////////////////////////////////////
+  static constexpr ChunkSize kMinSplitBlockSize = 4;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief The largest number of runs merged at once. Each of them keeps a
+  /// file open.
+  //////////////////////////////////////////////////////////////////////////////
+  static constexpr ChunksNumber kMaxFanIn = 512;
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of input tape buffers of the split: one, and one
+  /// more for the prefetched chunk.
+  ///
+  /// \return number of buffers.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetInputBuffersNumber() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the memory of the parallel split left by the input tape.
+  ///
+  /// \return memory in bytes.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] MemorySize GetSplitBlocksMemory() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of halves of a block the memory of the parallel
+  /// split is divided into: two for every block being read, sorted or
+  /// written, and one more for the scratch buffer of every sorting thread.
+  ///
+  /// \param threads_number number of sorting threads.
+  /// \return number of halves of a block.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] MemorySize GetSplitHalvesNumber(
+      ChunksNumber threads_number) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Memory for buffers in bytes.
+  //////////////////////////////////////////////////////////////////////////////
+  MemorySize memory_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Sorting options.
+  //////////////////////////////////////////////////////////////////////////////
+  SorterOptions options_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Runs are sorted with a scratch buffer of half a run.
+  //////////////////////////////////////////////////////////////////////////////
+  bool sort_scratch_ = false;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Part of the memory kept for the rest of the sorter: 1 / kReserve.
+  //////////////////////////////////////////////////////////////////////////////
+  static constexpr MemorySize kReserve = 16;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Replacement selection and the parallel split divide the memory
+  /// into kSplitShares shares. One of them is the buffer of the input tape,
+  /// one more is taken by prefetching.
+  //////////////////////////////////////////////////////////////////////////////
+  static constexpr MemorySize kSplitShares = 8;
+};
+
+template <typename TapeType>
+MemoryPlanner<TapeType>::MemoryPlanner(MemorySize memory,
+                                       const SorterOptions &options,
+                                       bool sort_scratch)
+    : memory_(memory - memory / kReserve),
+      options_(options),
+      sort_scratch_(sort_scratch) {}
+
+template <typename TapeType>
+ChunkSize MemoryPlanner<TapeType>::GetSplitChunkSize() const {
+  if (options_.run_generation_ == RunGeneration::kChunkSort &&
+      options_.threads_ <= 1) {
+    // Counted in halves of a chunk: the scratch buffer takes one.
+    MemorySize halves = 2 * GetInputBuffersNumber() + (sort_scratch_ ? 1 : 0);
+    return std::max<ChunkSize>(2 * memory_ / (halves * sizeof(TapeType)), 1);
+  }
+  return std::max<ChunkSize>(memory_ / kSplitShares / sizeof(TapeType), 1);
+}
+
+template <typename TapeType>
+template <typename HeapElement>
+ChunkSize MemoryPlanner<TapeType>::GetHeapSize() const {
+  // The input buffers and the buffer of the written run.
+  MemorySize buffers_memory =
+      (GetInputBuffersNumber() + 1) * (memory_ / kSplitShares);
+  return std::max<ChunkSize>((memory_ - buffers_memory) / sizeof(HeapElement),
+                             1);
+}
+
+template <typename TapeType>
+ChunksNumber MemoryPlanner<TapeType>::GetSplitThreadsNumber() const {
+  ChunksNumber threads_number = std::max<ChunksNumber>(options_.threads_, 1);
+  MemorySize halves_fitting = 2 * GetSplitBlocksMemory() /
+                              (kMinSplitBlockSize * sizeof(TapeType));
+  while (threads_number > 1 &&
+         GetSplitHalvesNumber(threads_number) > halves_fitting) {
+    threads_number--;
+  }
+  return threads_number;
+}
+
+template <typename TapeType>
+ChunkSize MemoryPlanner<TapeType>::GetSplitBlockSize() const {
+  MemorySize halves = GetSplitHalvesNumber(GetSplitThreadsNumber());
+  return std::max<ChunkSize>(
+      2 * GetSplitBlocksMemory() / halves / sizeof(TapeType), 1);
+}
+
+template <typename TapeType>
+ChunksNumber MemoryPlanner<TapeType>::GetMergesNumber() const {
+  // The smallest merge: two runs and the output with the tree of losers.
+  MemorySize merge_memory = (2 + 2) * kMinMergeBlockSize * sizeof(TapeType);
+  return std::clamp<ChunksNumber>(memory_ / merge_memory, 1,
+                                  std::max<ChunksNumber>(options_.threads_, 1));
+}
+
+template <typename TapeType>
+ChunksNumber MemoryPlanner<TapeType>::GetFanIn(
+    ChunksNumber runs_number, ChunksNumber merges_number) const {
+  MemorySize elements =
+      memory_ / std::max<ChunksNumber>(merges_number, 1) / sizeof(TapeType);
+  ChunksNumber fan_in = elements / kMinMergeBlockSize;
+  fan_in = fan_in > 2 ? fan_in - 2 : 0;
+  return std::clamp<ChunksNumber>(fan_in, 2,
+                                  std::max<ChunksNumber>(
+                                      std::min(runs_number, kMaxFanIn), 2));
+}
+
+template <typename TapeType>
+ChunkSize MemoryPlanner<TapeType>::GetMergeBlockSize(
+    ChunksNumber fan_in, ChunksNumber merges_number) const {
+  MemorySize elements =
+      memory_ / std::max<ChunksNumber>(merges_number, 1) / sizeof(TapeType);
+  return std::max<ChunkSize>(elements / (fan_in + 2), 1);
+}
+
+template <typename TapeType>
+ChunksNumber MemoryPlanner<TapeType>::GetInputBuffersNumber() const {
+  return options_.prefetch_ ? 2 : 1;
+}
+
+template <typename TapeType>
+MemorySize MemoryPlanner<TapeType>::GetSplitBlocksMemory() const {
+  return memory_ - GetInputBuffersNumber() * (memory_ / kSplitShares);
+}
+
+template <typename TapeType>
+MemorySize MemoryPlanner<TapeType>::GetSplitHalvesNumber(
+    ChunksNumber threads_number) const {
+  return 2 * (threads_number + 2) + (sort_scratch_ ? threads_number : 0);
+}
+}  // namespace tape
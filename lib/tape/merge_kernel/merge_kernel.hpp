@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <utility>
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Merge the heads of two sorted blocks into the output until one of
+/// the blocks or the output is exhausted. The next element is selected without
+/// branches; of equal elements the element of the first block goes first.
+///
+/// \tparam T type of elements.
+/// \tparam Compare strict weak ordering of elements.
+/// \param first first sorted block.
+/// \param second second sorted block.
+/// \param output buffer for the merged elements.
+/// \param compare strict weak ordering of elements.
+/// \return numbers of elements taken from the first and the second block.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T, typename Compare = std::less<T>>
+std::pair<std::size_t, std::size_t> MergeBlocks(std::span<const T> first,
+                                                std::span<const T> second,
+                                                std::span<T> output,
+                                                Compare compare = Compare{}) {
+  std::size_t i = 0;
+  std::size_t j = 0;
+  std::size_t k = 0;
+  while (true) {
+    // Every step takes one element, so none of the spans ends within them.
+    std::size_t steps = std::min({first.size() - i, second.size() - j,
+                                  output.size() - k});
+    if (!steps) {
+      return {i, j};
+    }
+    for (std::size_t step = 0; step < steps; step++) {
+      const T &x = first[i];
+      const T &y = second[j];
+      bool take_second = compare(y, x);
+      output[k++] = take_second ? y : x;
+      j += take_second;
+      i += !take_second;
+    }
+  }
+}
+}  // namespace tape
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <functional>
+#include <type_traits>
+
+#include "../record/record.hpp"
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Reversed strict weak ordering.
+///
+/// \tparam Compare ordering that is reversed.
+////////////////////////////////////////////////////////////////////////////////
+template <typename Compare>
+struct Reversed {
+  template <typename T>
+  constexpr bool operator()(const T &lhs, const T &rhs) const {
+    return compare_(rhs, lhs);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Reversed ordering.
+  //////////////////////////////////////////////////////////////////////////////
+  [[no_unique_address]] Compare compare_{};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Descending order, sorted as such without reversing an ascending
+/// result.
+///
+/// \tparam Compare ascending ordering.
+////////////////////////////////////////////////////////////////////////////////
+template <typename Compare = std::less<>>
+using Descending = Reversed<Compare>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Ordering of the values of a projection of elements.
+///
+/// \tparam Projection projection of elements.
+/// \tparam Compare ordering of the projected values.
+////////////////////////////////////////////////////////////////////////////////
+template <typename Projection, typename Compare = std::less<>>
+struct ByProjection {
+  template <typename T>
+  constexpr bool operator()(const T &lhs, const T &rhs) const {
+    return compare_(projection_(lhs), projection_(rhs));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Projection of elements.
+  //////////////////////////////////////////////////////////////////////////////
+  [[no_unique_address]] Projection projection_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Ordering of the projected values.
+  //////////////////////////////////////////////////////////////////////////////
+  [[no_unique_address]] Compare compare_{};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Absolute value of a number. The absolute value of a signed integer
+/// is unsigned, so that the one of the smallest integer does not overflow.
+////////////////////////////////////////////////////////////////////////////////
+struct AbsoluteValue {
+  template <typename T>
+  constexpr auto operator()(const T &value) const {
+    if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+      using Unsigned = std::make_unsigned_t<T>;
+      return value < 0 ? static_cast<Unsigned>(Unsigned{0} - value)
+                       : static_cast<Unsigned>(value);
+    } else {
+      return value < T{} ? -value : value;
+    }
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Ordering of numbers by their absolute values.
+///
+/// \tparam Compare ordering of the absolute values.
+////////////////////////////////////////////////////////////////////////////////
+template <typename Compare = std::less<>>
+using ByAbsoluteValue = ByProjection<AbsoluteValue, Compare>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Check if an ordering finds equivalent only equal values, so that the
+/// order of equivalent values cannot be seen.
+///
+/// \tparam Compare ordering.
+////////////////////////////////////////////////////////////////////////////////
+template <typename Compare>
+struct IsEqualityOrder : std::false_type {};
+
+template <typename T>
+struct IsEqualityOrder<std::less<T>> : std::true_type {};
+
+template <typename T>
+struct IsEqualityOrder<std::greater<T>> : std::true_type {};
+
+template <typename Compare>
+struct IsEqualityOrder<Reversed<Compare>> : IsEqualityOrder<Compare> {};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Check if an ordering is the ascending order of the values of T.
+///
+/// \tparam Compare ordering.
+/// \tparam T type of values.
+////////////////////////////////////////////////////////////////////////////////
+template <typename Compare, typename T>
+inline constexpr bool kIsAscendingOrder =
+    std::is_same_v<Compare, std::less<>> ||
+    std::is_same_v<Compare, std::less<T>>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Check if an ordering is the descending order of the values of T.
+///
+/// \tparam Compare ordering.
+/// \tparam T type of values.
+////////////////////////////////////////////////////////////////////////////////
+template <typename Compare, typename T>
+inline constexpr bool kIsDescendingOrder =
+    std::is_same_v<Compare, std::greater<>> ||
+    std::is_same_v<Compare, std::greater<T>> ||
+    std::is_same_v<Compare, Descending<>> ||
+    std::is_same_v<Compare, Descending<std::less<T>>>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Check if the order of elements with equivalent keys can be seen:
+/// with keys other than the whole elements, or with orderings other than
+/// equality ones, the sort keeps it.
+///
+/// \tparam KeyOfType key extractor.
+/// \tparam Compare ordering of keys.
+////////////////////////////////////////////////////////////////////////////////
+template <typename KeyOfType, typename Compare = std::less<>>
+inline constexpr bool kIsStableOrder =
+    !std::is_same_v<KeyOfType, WholeKey> || !IsEqualityOrder<Compare>::value;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Strict weak ordering of elements by their keys.
+///
+/// \tparam KeyOfType key extractor.
+/// \tparam Compare ordering of keys.
+////////////////////////////////////////////////////////////////////////////////
+template <typename KeyOfType, typename Compare = std::less<>>
+struct KeyLess {
+  template <typename T>
+  constexpr bool operator()(const T &lhs, const T &rhs) const {
+    return compare_(key_of_(lhs), key_of_(rhs));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Key extractor.
+  //////////////////////////////////////////////////////////////////////////////
+  [[no_unique_address]] KeyOfType key_of_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Ordering of keys.
+  //////////////////////////////////////////////////////////////////////////////
+  [[no_unique_address]] Compare compare_{};
+};
+}  // namespace tape
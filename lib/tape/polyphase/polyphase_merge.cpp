@@ -0,0 +1,214 @@
+#include "polyphase_merge.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace tape {
+PolyphaseMerge::PolyphaseMerge(ChunksNumber tapes_number, bool read_backward)
+    : level_runs_(tapes_number > 1 ? tapes_number - 1 : 0, 1),
+      dummy_runs_(tapes_number, 1),
+      runs_(tapes_number),
+      sizes_(tapes_number),
+      output_tape_(tapes_number > 1 ? tapes_number - 1 : 0),
+      read_backward_(read_backward) {
+  if (tapes_number < 3) {
+    throw std::invalid_argument("Polyphase merge needs at least 3 tapes");
+  }
+  dummy_runs_[output_tape_] = 0;
+}
+
+std::vector<bool> PolyphaseMerge::PlanDescendingRuns(
+    ChunksNumber tapes_number, ChunksNumber runs_number) {
+  PolyphaseMerge schedule(tapes_number, true);
+  for (ChunksNumber run = 0; run < runs_number; run++) {
+    schedule.AddRun(1);
+  }
+  while (schedule.GetPhasesNumber()) {
+    for (ChunksNumber merges_number = schedule.GetMergesNumber();
+         merges_number; merges_number--) {
+      static_cast<void>(schedule.TakeMerge());
+    }
+    if (schedule.GetPhasesNumber() == 1) {
+      break;
+    }
+    schedule.EndPhase();
+  }
+
+  std::vector<bool> descending(runs_number);
+  for (ChunksNumber run = 0; run < runs_number; run++) {
+    for (ChunksNumber merged = schedule.merged_into_[run]; merged;
+         merged = schedule.merged_into_[merged]) {
+      descending[run] = !descending[run];
+    }
+  }
+  return descending;
+}
+
+ChunksNumber PolyphaseMerge::GetTapesNumber() const {
+  return static_cast<ChunksNumber>(runs_.size());
+}
+
+bool PolyphaseMerge::IsReadBackward() const {
+  return read_backward_;
+}
+
+ChunksNumber PolyphaseMerge::GetNextRunTape() {
+  if (advance_run_tape_) {
+    AdvanceRunTape();
+    advance_run_tape_ = false;
+  }
+  return run_tape_;
+}
+
+void PolyphaseMerge::AddRun(TapeSize size, bool descending) {
+  ChunksNumber tape = GetNextRunTape();
+  dummy_runs_[tape]--;
+  runs_[tape].push_back(
+      {size, descending, static_cast<ChunksNumber>(merged_into_.size())});
+  merged_into_.push_back(0);
+  sizes_[tape] += size;
+  runs_number_++;
+  advance_run_tape_ = true;
+}
+
+bool PolyphaseMerge::IsNextMergeDescending() const {
+  bool descending = false;
+  bool first = true;
+  for (ChunksNumber tape = 0; tape < GetTapesNumber(); tape++) {
+    if (tape == output_tape_ || dummy_runs_[tape] || runs_[tape].empty()) {
+      continue;
+    }
+    bool run_descending = GetNextRun(tape).descending_ != read_backward_;
+    if (!first && run_descending != descending) {
+      throw std::logic_error("Polyphase merge runs come in different orders");
+    }
+    descending = run_descending;
+    first = false;
+  }
+  return descending;
+}
+
+ChunksNumber PolyphaseMerge::GetRunsNumber() const {
+  return runs_number_;
+}
+
+ChunksNumber PolyphaseMerge::GetPhasesNumber() const {
+  return level_;
+}
+
+ChunksNumber PolyphaseMerge::GetOutputTape() const {
+  return output_tape_;
+}
+
+TapeSize PolyphaseMerge::GetTapeSize(ChunksNumber tape) const {
+  return sizes_[tape];
+}
+
+ChunksNumber PolyphaseMerge::GetMergesNumber() const {
+  ChunksNumber merges_number = 0;
+  bool first = true;
+  for (ChunksNumber tape = 0; tape < GetTapesNumber(); tape++) {
+    if (tape == output_tape_) {
+      continue;
+    }
+    auto tape_runs =
+        static_cast<ChunksNumber>(dummy_runs_[tape] + runs_[tape].size());
+    merges_number = first ? tape_runs : std::min(merges_number, tape_runs);
+    first = false;
+  }
+  return merges_number;
+}
+
+std::vector<TapeSize> PolyphaseMerge::TakeMerge() {
+  std::vector<TapeSize> merge(GetTapesNumber());
+  Run merged{0, false, static_cast<ChunksNumber>(merged_into_.size())};
+  bool dummy = true;
+  for (ChunksNumber tape = 0; tape < GetTapesNumber(); tape++) {
+    if (tape == output_tape_) {
+      continue;
+    }
+    if (dummy_runs_[tape]) {
+      dummy_runs_[tape]--;
+      continue;
+    }
+    if (runs_[tape].empty()) {
+      throw std::logic_error("Polyphase merge phase is over");
+    }
+    const Run &run = GetNextRun(tape);
+    if (dummy) {
+      // The merged run is written in the order its runs come.
+      merged.descending_ = run.descending_ != read_backward_;
+    }
+    merge[tape] = run.size_;
+    merged.size_ += run.size_;
+    merged_into_[run.number_] = merged.number_;
+    if (read_backward_) {
+      runs_[tape].pop_back();
+    } else {
+      runs_[tape].pop_front();
+    }
+    dummy = false;
+  }
+
+  if (dummy) {
+    dummy_runs_[output_tape_]++;
+  } else {
+    runs_[output_tape_].push_back(merged);
+    merged_into_.push_back(0);
+    sizes_[output_tape_] += merged.size_;
+  }
+  return merge;
+}
+
+void PolyphaseMerge::SetMergedRunSize(TapeSize size) {
+  std::deque<Run> &output_runs = runs_[output_tape_];
+  if (output_runs.empty() ||
+      output_runs.back().number_ + 1 != merged_into_.size()) {
+    throw std::logic_error("Polyphase merge has not merged a run");
+  }
+  Run &merged = output_runs.back();
+  sizes_[output_tape_] = sizes_[output_tape_] - merged.size_ + size;
+  merged.size_ = size;
+}
+
+ChunksNumber PolyphaseMerge::GetEmptiedTape() const {
+  for (ChunksNumber tape = 0; tape < GetTapesNumber(); tape++) {
+    if (tape != output_tape_ && !dummy_runs_[tape] && runs_[tape].empty()) {
+      return tape;
+    }
+  }
+  throw std::logic_error("Polyphase merge phase is not over");
+}
+
+void PolyphaseMerge::EndPhase() {
+  ChunksNumber emptied = GetEmptiedTape();
+  sizes_[emptied] = 0;
+  output_tape_ = emptied;
+  level_--;
+}
+
+const PolyphaseMerge::Run &PolyphaseMerge::GetNextRun(
+    ChunksNumber tape) const {
+  return read_backward_ ? runs_[tape].back() : runs_[tape].front();
+}
+
+void PolyphaseMerge::AdvanceRunTape() {
+  auto inputs_number = static_cast<ChunksNumber>(level_runs_.size());
+  if (run_tape_ + 1 < inputs_number &&
+      dummy_runs_[run_tape_] < dummy_runs_[run_tape_ + 1]) {
+    run_tape_++;
+    return;
+  }
+  if (!dummy_runs_[run_tape_]) {
+    ChunksNumber first_runs = level_runs_.front();
+    for (ChunksNumber tape = 0; tape < inputs_number; tape++) {
+      ChunksNumber next_runs =
+          tape + 1 < inputs_number ? level_runs_[tape + 1] : 0;
+      dummy_runs_[tape] = first_runs + next_runs - level_runs_[tape];
+      level_runs_[tape] = first_runs + next_runs;
+    }
+    level_++;
+  }
+  run_tape_ = 0;
+}
+}  // namespace tape
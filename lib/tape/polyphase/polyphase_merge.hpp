@@ -0,0 +1,237 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "../chunk/chunk.hpp"
+#include "../tape_interface.hpp"
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Schedule of a polyphase merge on a fixed number of physical tapes.
+/// Runs are distributed on all tapes but one by the generalized Fibonacci
+/// numbers, the missing runs of the last level are dummy runs at the
+/// beginning of the tapes. Every phase merges a run of each input tape onto
+/// the output tape until one input tape is empty; it becomes the output tape
+/// of the next phase. The last phase merges one run of every input tape.
+///
+/// Tapes read backward give their runs from the last one and reversed, so a
+/// merge turns the order of its runs. Every run of a merge must come in the
+/// same order, and the result must be ascending: a run is written descending
+/// if it is merged an odd number of times.
+////////////////////////////////////////////////////////////////////////////////
+class PolyphaseMerge {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief PolyphaseMerge constructor. Throws std::invalid_argument for less
+  /// than three tapes.
+  ///
+  /// \param tapes_number number of physical tapes.
+  /// \param read_backward the tapes are read backward, without rewinds.
+  //////////////////////////////////////////////////////////////////////////////
+  explicit PolyphaseMerge(ChunksNumber tapes_number,
+                          bool read_backward = false);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Plan the orders of the runs of a merge of tapes read backward.
+  ///
+  /// \param tapes_number number of physical tapes.
+  /// \param runs_number number of runs.
+  /// \return for every run in the order they are added: true if the run is
+  /// written descending.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] static std::vector<bool> PlanDescendingRuns(
+      ChunksNumber tapes_number, ChunksNumber runs_number);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of physical tapes.
+  ///
+  /// \return number of tapes.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetTapesNumber() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Check if the tapes are read backward.
+  ///
+  /// \return true if the tapes are read backward.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] bool IsReadBackward() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the tape the next run is written to. A new level of the
+  /// distribution is started when the runs of the current one are written.
+  ///
+  /// \return number of the tape.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetNextRunTape();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Add a run written to the tape returned by GetNextRunTape.
+  ///
+  /// \param size size of the run.
+  /// \param descending the run is written descending.
+  //////////////////////////////////////////////////////////////////////////////
+  void AddRun(TapeSize size, bool descending = false);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Check if the runs of the next merge come in descending order.
+  /// Throws std::logic_error if the runs come in different orders.
+  ///
+  /// \return true if the runs come descending.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] bool IsNextMergeDescending() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of runs added by AddRun.
+  ///
+  /// \return number of runs.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetRunsNumber() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of phases left.
+  ///
+  /// \return number of phases.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetPhasesNumber() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the output tape of the current phase.
+  ///
+  /// \return number of the tape.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetOutputTape() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of elements written to a tape since it was the
+  /// output tape.
+  ///
+  /// \param tape number of the tape.
+  /// \return number of elements.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] TapeSize GetTapeSize(ChunksNumber tape) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of merges of the current phase.
+  ///
+  /// \return number of merges.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetMergesNumber() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Take the runs of the next merge of the current phase: a run of
+  /// every input tape, a dummy run first, then the first run or the last one
+  /// if the tape is read backward. The merged run is added to the output
+  /// tape.
+  ///
+  /// \return sizes of the runs by tapes: zero for dummy runs and the output
+  /// tape.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::vector<TapeSize> TakeMerge();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Set the size of the run added by the last merge of runs, smaller
+  /// than the sum of their sizes if the merge combined equal elements.
+  /// Throws std::logic_error if the last merge was one of dummy runs.
+  ///
+  /// \param size size of the merged run.
+  //////////////////////////////////////////////////////////////////////////////
+  void SetMergedRunSize(TapeSize size);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the input tape emptied by the merges of the current phase.
+  ///
+  /// \return number of the tape.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetEmptiedTape() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Finish the current phase: the emptied input tape becomes the
+  /// output tape.
+  //////////////////////////////////////////////////////////////////////////////
+  void EndPhase();
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Run of a tape.
+  //////////////////////////////////////////////////////////////////////////////
+  struct Run {
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief Size of the run.
+    ////////////////////////////////////////////////////////////////////////////
+    TapeSize size_{};
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief The run is written descending.
+    ////////////////////////////////////////////////////////////////////////////
+    bool descending_ = false;
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief Number of the run: the runs added by AddRun go first, then the
+    /// merged ones.
+    ////////////////////////////////////////////////////////////////////////////
+    ChunksNumber number_{};
+  };
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the next run of an input tape without dummy runs.
+  ///
+  /// \param tape number of the tape.
+  /// \return run.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] const Run &GetNextRun(ChunksNumber tape) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Go to the tape of the next run (Knuth's algorithm D): to the next
+  /// tape while it lacks more runs, else to the first tape, starting a new
+  /// level when no runs are lacking.
+  //////////////////////////////////////////////////////////////////////////////
+  void AdvanceRunTape();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of runs of every input tape at the current level of the
+  /// distribution.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<ChunksNumber> level_runs_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of dummy runs of every tape.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<ChunksNumber> dummy_runs_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Runs of every tape in the order they are written.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<std::deque<Run>> runs_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of the run every run is merged into, zero for the result
+  /// of the last phase.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<ChunksNumber> merged_into_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of elements written to every tape.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<TapeSize> sizes_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Tape of the next run of the distribution.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunksNumber run_tape_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief The tape of the next run is chosen on demand, so that the level
+  /// is not increased after the last run.
+  //////////////////////////////////////////////////////////////////////////////
+  bool advance_run_tape_ = false;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of runs added by AddRun.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunksNumber runs_number_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Level of the distribution: the number of phases left.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunksNumber level_ = 1;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Output tape of the current phase.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunksNumber output_tape_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief The tapes are read backward.
+  //////////////////////////////////////////////////////////////////////////////
+  bool read_backward_ = false;
+};
+}  // namespace tape
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <type_traits>
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Fixed-size record of a tape: a key the records are sorted by and a
+/// payload carried with it. Records of trivially copyable keys and payloads
+/// are stored in binary tapes as they are.
+///
+/// \tparam Key type of the key.
+/// \tparam Payload type of the payload.
+////////////////////////////////////////////////////////////////////////////////
+template <typename Key, typename Payload>
+struct Record {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Key of the record.
+  //////////////////////////////////////////////////////////////////////////////
+  Key key_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Payload of the record.
+  //////////////////////////////////////////////////////////////////////////////
+  Payload payload_{};
+
+  bool operator==(const Record &other) const = default;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Read a record of a text tape: the key and the payload separated by
+/// whitespace.
+///
+/// \param from stream from where the record is read.
+/// \param record read record.
+/// \return stream.
+////////////////////////////////////////////////////////////////////////////////
+template <typename Key, typename Payload>
+std::istream &operator>>(std::istream &from, Record<Key, Payload> &record) {
+  return from >> record.key_ >> record.payload_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Write a record to a text tape: the key and the payload separated by
+/// a space.
+///
+/// \param to stream where the record is written.
+/// \param record written record.
+/// \return stream.
+////////////////////////////////////////////////////////////////////////////////
+template <typename Key, typename Payload>
+std::ostream &operator<<(std::ostream &to,
+                         const Record<Key, Payload> &record) {
+  return to << record.key_ << ' ' << record.payload_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Key extractor of elements that are keys themselves.
+////////////////////////////////////////////////////////////////////////////////
+struct WholeKey {
+  template <typename T>
+  constexpr const T &operator()(const T &element) const noexcept {
+    return element;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Key extractor of records.
+////////////////////////////////////////////////////////////////////////////////
+struct RecordKey {
+  template <typename Key, typename Payload>
+  constexpr const Key &operator()(
+      const Record<Key, Payload> &record) const noexcept {
+    return record.key_;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Default key extractor of a type of elements.
+///
+/// \tparam T type of elements.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+struct DefaultKeyOf {
+  using Type = WholeKey;
+};
+
+template <typename Key, typename Payload>
+struct DefaultKeyOf<Record<Key, Payload>> {
+  using Type = RecordKey;
+};
+
+template <typename T>
+using KeyOf = typename DefaultKeyOf<T>::Type;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Check if elements are records whose payloads count their keys:
+/// records with integer payloads other than bool.
+///
+/// \tparam T type of elements.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline constexpr bool kIsCountRecord = false;
+
+template <typename Key, typename Payload>
+inline constexpr bool kIsCountRecord<Record<Key, Payload>> =
+    std::is_integral_v<Payload> && !std::is_same_v<Payload, bool>;
+}  // namespace tape
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "../memory_budget/budget_allocator.hpp"
+#include "../merge_kernel/merge_kernel.hpp"
+#include "../order/order.hpp"
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Runs of this size or smaller are sorted by std::sort: counting the
+/// digits of a few elements costs more than comparing them.
+////////////////////////////////////////////////////////////////////////////////
+inline constexpr std::size_t kRadixSortThreshold = 256;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Runs of this size or smaller are sorted by insertion sort by the
+/// stable merge sort.
+////////////////////////////////////////////////////////////////////////////////
+inline constexpr std::size_t kInsertionSortThreshold = 32;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Number of bits of a radix sort digit.
+////////////////////////////////////////////////////////////////////////////////
+inline constexpr int kRadixDigitBits = 8;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Types sorted by the radix sort: integers other than bool.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+concept RadixSortable = std::is_integral_v<T> && !std::is_same_v<T, bool>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Get the unsigned key of an integer ordered as the integer: the sign
+/// bit of a signed integer is flipped.
+///
+/// \tparam T type of the integer.
+/// \param element integer.
+/// \return key.
+////////////////////////////////////////////////////////////////////////////////
+template <RadixSortable T>
+[[nodiscard]] constexpr std::make_unsigned_t<T> RadixKey(T element) {
+  using Key = std::make_unsigned_t<T>;
+  auto key = static_cast<Key>(element);
+  if constexpr (std::is_signed_v<T>) {
+    key ^= static_cast<Key>(Key{1} << (sizeof(T) * 8 - 1));
+  }
+  return key;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Sort integers by their digits from the digit at the shift down, in
+/// place (American flag sort): the elements are counted by the digit and
+/// swapped into their buckets, then every bucket is sorted by the next digit.
+///
+/// \tparam T type of the integers.
+/// \tparam kDescending sort in descending order: the digits are inverted.
+/// \param elements integers.
+/// \param shift shift of the digit.
+////////////////////////////////////////////////////////////////////////////////
+template <RadixSortable T, bool kDescending = false>
+void RadixSort(std::span<T> elements, int shift) {
+  using Key = std::make_unsigned_t<T>;
+  constexpr std::size_t kDigits = std::size_t{1} << kRadixDigitBits;
+  constexpr auto kMask = static_cast<Key>(kDigits - 1);
+  auto digit = [&shift](T element) {
+    Key key = RadixKey(element);
+    if constexpr (kDescending) {
+      key = static_cast<Key>(~key);
+    }
+    return static_cast<std::size_t>((key >> shift) & kMask);
+  };
+
+  std::array<std::size_t, kDigits> counts{};
+  while (true) {
+    if (elements.size() <= kRadixSortThreshold) {
+      if constexpr (kDescending) {
+        std::sort(elements.begin(), elements.end(), std::greater<T>{});
+      } else {
+        std::sort(elements.begin(), elements.end());
+      }
+      return;
+    }
+    counts.fill(0);
+    for (T element : elements) {
+      counts[digit(element)]++;
+    }
+    if (counts[digit(elements.front())] != elements.size()) {
+      break;
+    }
+    // All the elements have the same digit: go to the next one.
+    if (shift == 0) {
+      return;
+    }
+    shift -= kRadixDigitBits;
+  }
+
+  std::array<std::size_t, kDigits> heads{};
+  std::array<std::size_t, kDigits> tails{};
+  std::size_t offset = 0;
+  for (std::size_t i = 0; i < kDigits; i++) {
+    heads[i] = offset;
+    offset += counts[i];
+    tails[i] = offset;
+  }
+
+  for (std::size_t bucket = 0; bucket < kDigits; bucket++) {
+    while (heads[bucket] < tails[bucket]) {
+      T element = elements[heads[bucket]];
+      std::size_t element_digit = digit(element);
+      while (element_digit != bucket) {
+        std::swap(element, elements[heads[element_digit]++]);
+        element_digit = digit(element);
+      }
+      elements[heads[bucket]++] = element;
+    }
+  }
+
+  if (shift == 0) {
+    return;
+  }
+  std::size_t begin = 0;
+  for (std::size_t bucket = 0; bucket < kDigits; bucket++) {
+    std::size_t end = tails[bucket];
+    if (end - begin > 1) {
+      RadixSort<T, kDescending>(elements.subspan(begin, end - begin),
+                                shift - kRadixDigitBits);
+    }
+    begin = end;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Sort a run stably by merge sort: both halves are sorted, the first
+/// one is moved to the scratch buffer and merged with the second one into the
+/// run by MergeBlocks, which takes equivalent elements from the first half
+/// first.
+///
+/// \tparam T type of elements.
+/// \tparam Less strict weak ordering of elements.
+/// \param elements elements of the run.
+/// \param scratch buffer of at least half of the run.
+/// \param less strict weak ordering of elements.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T, typename Less>
+void StableSortRun(std::span<T> elements, std::span<T> scratch, Less less) {
+  if (elements.size() <= kInsertionSortThreshold) {
+    for (std::size_t i = 1; i < elements.size(); i++) {
+      T element = elements[i];
+      std::size_t j = i;
+      for (; j > 0 && less(element, elements[j - 1]); j--) {
+        elements[j] = elements[j - 1];
+      }
+      elements[j] = element;
+    }
+    return;
+  }
+  std::size_t middle = elements.size() / 2;
+  StableSortRun(elements.first(middle), scratch, less);
+  StableSortRun(elements.subspan(middle), scratch, less);
+  if (!less(elements[middle], elements[middle - 1])) {
+    return;
+  }
+
+  // The merged elements never overtake the unmerged ones of the second half.
+  std::span<T> first = scratch.first(middle);
+  std::copy(elements.begin(), elements.begin() + middle, first.begin());
+  auto [taken_first, taken_second] = MergeBlocks<T, Less>(
+      first, elements.subspan(middle), elements, less);
+  // The rest of the second half is in its place already.
+  std::copy(first.begin() + taken_first, first.end(),
+            elements.begin() + taken_first + taken_second);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Sort a run in memory. Integers in ascending or descending order are
+/// sorted in place by the radix sort, other types and orders in place by
+/// std::sort. Elements whose order of equivalent keys can be seen, such as
+/// records, are sorted by StableSortRun, so that equivalent keys keep their
+/// order; its scratch buffer of half the run is taken from the budget.
+///
+/// \tparam T type of elements.
+/// \tparam KeyOfType key extractor.
+/// \tparam Compare ordering of keys.
+/// \param elements elements of the run.
+/// \param budget memory budget of the scratch buffer, if any.
+////////////////////////////////////////////////////////////////////////////////
+template <typename T, typename KeyOfType = WholeKey,
+          typename Compare = std::less<>>
+void SortRun(std::span<T> elements,
+             const std::shared_ptr<MemoryBudget> &budget = nullptr) {
+  constexpr int kShift = static_cast<int>(sizeof(T) * 8) - kRadixDigitBits;
+  if constexpr (kIsStableOrder<KeyOfType, Compare>) {
+    BudgetVector<T> scratch(elements.size() / 2, BudgetAllocator<T>(budget));
+    StableSortRun(elements, std::span<T>(scratch),
+                  KeyLess<KeyOfType, Compare>{});
+  } else if constexpr (RadixSortable<T> && kIsAscendingOrder<Compare, T>) {
+    RadixSort<T, false>(elements, kShift);
+  } else if constexpr (RadixSortable<T> && kIsDescendingOrder<Compare, T>) {
+    RadixSort<T, true>(elements, kShift);
+  } else {
+    std::sort(elements.begin(), elements.end(), KeyLess<KeyOfType, Compare>{});
+  }
+}
+}  // namespace tape
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../polyphase/polyphase_merge.hpp"
+#include "../tape.hpp"
+#include "../writer/tape_writer.hpp"
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Storage of the runs made by the split. Every run is written to a
+/// temporary tape of its own, or with physical tapes to one of them chosen by
+/// the distribution of a polyphase merge.
+///
+/// \tparam TapeType type of elements in tapes.
+////////////////////////////////////////////////////////////////////////////////
+template <typename TapeType>
+class RunStore {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief RunStore constructor.
+  ///
+  /// \param dir directory of the temporary tapes.
+  /// \param context delays and the memory budget of the temporary tapes.
+  /// \param format format of the temporary tapes.
+  /// \param tapes_number number of physical tapes. With zero every run gets
+  /// a temporary tape of its own.
+  /// \param read_backward the physical tapes are read backward.
+  //////////////////////////////////////////////////////////////////////////////
+  RunStore(const std::filesystem::path &dir, const TapeContext &context,
+           TapeFormat format, ChunksNumber tapes_number = 0,
+           bool read_backward = false);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Plan the orders of the runs on physical tapes read backward. The
+  /// runs must be written in the planned orders.
+  ///
+  /// \param runs_number number of runs.
+  //////////////////////////////////////////////////////////////////////////////
+  void PlanRuns(ChunksNumber runs_number);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Check if the next run must be written descending.
+  ///
+  /// \return true for a descending run else false.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] bool IsNextRunDescending() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Start writing a new run. The previous run must be ended.
+  ///
+  /// \param buffer_size number of elements buffered by the writer of a run on
+  /// a temporary tape of its own. Runs on physical tapes are not buffered.
+  /// \return writer of the run.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeWriter<TapeType> &StartRun(ChunkSize buffer_size);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief End the run written after StartRun.
+  //////////////////////////////////////////////////////////////////////////////
+  void EndRun();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Close the writers of the physical tapes.
+  //////////////////////////////////////////////////////////////////////////////
+  void Close();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of written runs.
+  ///
+  /// \return number of runs.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetRunsNumber() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Check if the runs are written to physical tapes.
+  ///
+  /// \return true for physical tapes else false.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] bool IsPolyphase() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Take the tapes of the runs written to tapes of their own.
+  ///
+  /// \return runs.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::vector<Tape<TapeType>> TakeRuns();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the schedule of the polyphase merge of the runs written to
+  /// physical tapes.
+  ///
+  /// \return schedule of the merge.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] PolyphaseMerge &GetSchedule();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the path to the file of a physical tape.
+  ///
+  /// \param tape number of the tape.
+  /// \return path to the file of the tape.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::filesystem::path GetTapePath(ChunksNumber tape) const;
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Make the path of a temporary tape and count the tape.
+  ///
+  /// \param number number of the tape in the directory.
+  /// \return path of the temporary tape.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::filesystem::path MakeTapePath(std::size_t number) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Directory of the temporary tapes.
+  //////////////////////////////////////////////////////////////////////////////
+  std::filesystem::path dir_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Delays and the memory budget of the temporary tapes.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeContext context_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Format of the temporary tapes.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeFormat format_ = TapeFormat::kBinary;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Runs written to tapes of their own.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<Tape<TapeType>> runs_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Writer of the current run on a tape of its own.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeWriter<TapeType> run_writer_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Buffer size of the writer of the current run.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunkSize buffer_size_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Schedule of the polyphase merge of the physical tapes.
+  //////////////////////////////////////////////////////////////////////////////
+  std::optional<PolyphaseMerge> schedule_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Planned orders of the runs: true for a descending run.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<bool> descending_runs_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Writers of the physical tapes, opened by their first run.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<std::optional<TapeWriter<TapeType>>> tape_writers_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Physical tape of the current run.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunksNumber run_tape_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Size of the physical tape of the current run before it.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeSize run_start_{};
+};
+
+template <typename TapeType>
+RunStore<TapeType>::RunStore(const std::filesystem::path &dir,
+                             const TapeContext &context, TapeFormat format,
+                             ChunksNumber tapes_number, bool read_backward)
+    : dir_(dir), context_(context), format_(format) {
+  if (tapes_number) {
+    schedule_.emplace(tapes_number, read_backward);
+    tape_writers_.resize(tapes_number);
+  }
+  if (read_backward && !tapes_number) {
+    throw std::invalid_argument("Only physical tapes are read backward");
+  }
+}
+
+template <typename TapeType>
+void RunStore<TapeType>::PlanRuns(ChunksNumber runs_number) {
+  if (schedule_ && schedule_->IsReadBackward()) {
+    descending_runs_ = PolyphaseMerge::PlanDescendingRuns(
+        schedule_->GetTapesNumber(), runs_number);
+  }
+}
+
+template <typename TapeType>
+bool RunStore<TapeType>::IsNextRunDescending() const {
+  ChunksNumber run = GetRunsNumber();
+  return run < descending_runs_.size() && descending_runs_[run];
+}
+
+template <typename TapeType>
+TapeWriter<TapeType> &RunStore<TapeType>::StartRun(ChunkSize buffer_size) {
+  if (!schedule_) {
+    buffer_size_ = buffer_size;
+    run_writer_ = TapeWriter<TapeType>{MakeTapePath(runs_.size()), buffer_size,
+                                       context_, format_};
+    return run_writer_;
+  }
+
+  run_tape_ = schedule_->GetNextRunTape();
+  std::optional<TapeWriter<TapeType>> &writer = tape_writers_[run_tape_];
+  if (!writer) {
+    writer.emplace(MakeTapePath(run_tape_), 1, context_, format_);
+  }
+  run_start_ = writer->GetWrittenSize();
+  return *writer;
+}
+
+template <typename TapeType>
+void RunStore<TapeType>::EndRun() {
+  if (!schedule_) {
+    run_writer_.Close();
+    TapeSize run_size = run_writer_.GetWrittenSize();
+    runs_.push_back(Tape<TapeType>{run_writer_.GetTapeFilePath(), run_size,
+                                   std::min<ChunkSize>(buffer_size_, run_size),
+                                   format_, context_});
+    return;
+  }
+
+  bool descending = IsNextRunDescending();
+  schedule_->AddRun(tape_writers_[run_tape_]->GetWrittenSize() - run_start_,
+                    descending);
+}
+
+template <typename TapeType>
+void RunStore<TapeType>::Close() {
+  for (std::optional<TapeWriter<TapeType>> &writer : tape_writers_) {
+    if (writer) {
+      writer->Close();
+    }
+  }
+}
+
+template <typename TapeType>
+ChunksNumber RunStore<TapeType>::GetRunsNumber() const {
+  return schedule_ ? schedule_->GetRunsNumber()
+                   : static_cast<ChunksNumber>(runs_.size());
+}
+
+template <typename TapeType>
+bool RunStore<TapeType>::IsPolyphase() const {
+  return schedule_.has_value();
+}
+
+template <typename TapeType>
+std::vector<Tape<TapeType>> RunStore<TapeType>::TakeRuns() {
+  return std::move(runs_);
+}
+
+template <typename TapeType>
+PolyphaseMerge &RunStore<TapeType>::GetSchedule() {
+  return *schedule_;
+}
+
+template <typename TapeType>
+std::filesystem::path RunStore<TapeType>::GetTapePath(
+    ChunksNumber tape) const {
+  std::filesystem::path tape_file = dir_;
+  tape_file += std::to_string(tape) + ".bin";
+  return tape_file;
+}
+
+template <typename TapeType>
+std::filesystem::path RunStore<TapeType>::MakeTapePath(
+    std::size_t number) const {
+  context_.Count(TapeCounter::kTempFiles);
+  return GetTapePath(static_cast<ChunksNumber>(number));
+}
+}  // namespace tape
@@ -0,0 +1,28 @@
+#include "sorter_options.hpp"
+
+#include <stdexcept>
+
+namespace tape {
+RunGeneration ParseRunGeneration(const std::string &name) {
+  if (name == "chunk_sort") {
+    return RunGeneration::kChunkSort;
+  }
+  if (name == "replacement_selection") {
+    return RunGeneration::kReplacementSelection;
+  }
+  throw std::invalid_argument("Unknown run generation mode: " + name);
+}
+
+Aggregation ParseAggregation(const std::string &name) {
+  if (name == "none") {
+    return Aggregation::kNone;
+  }
+  if (name == "unique") {
+    return Aggregation::kUnique;
+  }
+  if (name == "count") {
+    return Aggregation::kCount;
+  }
+  throw std::invalid_argument("Unknown aggregation mode: " + name);
+}
+}  // namespace tape
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Way of splitting the input tape into sorted runs.
+////////////////////////////////////////////////////////////////////////////////
+enum class RunGeneration : uint8_t {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Every chunk of the input tape is sorted in memory and becomes a
+  /// run.
+  //////////////////////////////////////////////////////////////////////////////
+  kChunkSort,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Runs are produced by a heap of one chunk size: about two chunks
+  /// long on random input and one run on already sorted input.
+  //////////////////////////////////////////////////////////////////////////////
+  kReplacementSelection
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Parse the run generation mode from its config name: "chunk_sort" or
+/// "replacement_selection". Throws std::invalid_argument for other names.
+///
+/// \param name name of the mode.
+/// \return run generation mode.
+////////////////////////////////////////////////////////////////////////////////
+[[nodiscard]] RunGeneration ParseRunGeneration(const std::string &name);
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief What is made of elements with equivalent keys.
+////////////////////////////////////////////////////////////////////////////////
+enum class Aggregation : uint8_t {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Every element is kept.
+  //////////////////////////////////////////////////////////////////////////////
+  kNone,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Only the first of the elements with equivalent keys is kept, as
+  /// by sort -u.
+  //////////////////////////////////////////////////////////////////////////////
+  kUnique,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Records with equivalent keys become the first of them with the
+  /// sum of their payloads, the counts of the keys. Only records with integer
+  /// payloads are counted.
+  //////////////////////////////////////////////////////////////////////////////
+  kCount
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Parse the aggregation mode from its config name: "none", "unique"
+/// or "count". Throws std::invalid_argument for other names.
+///
+/// \param name name of the mode.
+/// \return aggregation mode.
+////////////////////////////////////////////////////////////////////////////////
+[[nodiscard]] Aggregation ParseAggregation(const std::string &name);
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Options of TapeSorter.
+////////////////////////////////////////////////////////////////////////////////
+struct SorterOptions {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Way of splitting the input tape into sorted runs.
+  //////////////////////////////////////////////////////////////////////////////
+  RunGeneration run_generation_ = RunGeneration::kChunkSort;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of threads sorting chunks while the next chunk is read and
+  /// merging groups of runs of a merge pass concurrently. One thread sorts
+  /// the tape sequentially.
+  //////////////////////////////////////////////////////////////////////////////
+  uint32_t threads_ = 1;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Read the next chunk of the input tape and of the merged runs in
+  /// the background. Merge buffers are halved to leave room for it.
+  //////////////////////////////////////////////////////////////////////////////
+  bool prefetch_ = false;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Read the binary runs of the merge through memory mappings. The
+  /// merge buffer size becomes the window advised to the kernel.
+  //////////////////////////////////////////////////////////////////////////////
+  bool mapped_merge_ = false;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of physical tapes, at least three, the runs are merged on
+  /// by a polyphase merge. Fewer of them are used if the cost model finds it
+  /// cheaper. Zero merges the runs through a temporary tape per run, as do
+  /// sorts that keep the order of equal keys.
+  //////////////////////////////////////////////////////////////////////////////
+  uint32_t merge_tapes_ = 0;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Read the physical tapes of the polyphase merge backward, so that
+  /// no tape is rewound. Runs are written ascending or descending by the
+  /// number of times they are merged, which replacement selection does not
+  /// know in advance: its runs are read forward.
+  //////////////////////////////////////////////////////////////////////////////
+  bool read_backward_ = false;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Combine elements with equivalent keys while runs are made and
+  /// merged, so that runs of few unique keys shrink before they are written.
+  //////////////////////////////////////////////////////////////////////////////
+  Aggregation aggregation_ = Aggregation::kNone;
+};
+}  // namespace tape
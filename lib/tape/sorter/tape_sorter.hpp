@@ -1,16 +1,50 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <semaphore>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 
+#include "../aggregation/aggregation.hpp"
+#include "../cost_model/cost_model.hpp"
+#include "../loser_tree/loser_tree.hpp"
+#include "../mapped_tape/mapped_tape.hpp"
+#include "../memory_planner/memory_planner.hpp"
+#include "../merge_kernel/merge_kernel.hpp"
+#include "../order/order.hpp"
+#include "../record/record.hpp"
+#include "../run_sort/run_sort.hpp"
+#include "../run_store/run_store.hpp"
+#include "../stats/sort_stats.hpp"
 #include "../tape.hpp"
+#include "../thread_pool/thread_pool.hpp"
+#include "sorter_options.hpp"
 
 namespace tape {
 
 ////////////////////////////////////////////////////////////////////////////////
-/// \brief A class for sorting the tape.
+/// \brief A class for sorting the tape. Elements are ordered by their keys;
+/// elements with equivalent keys that can be told apart, such as records,
+/// keep their order in the input tape. The ordering and the key extractor are
+/// resolved at compile time.
 /// \tparam TapeType type of elements in tapes.
+/// \tparam Compare ordering of keys, see order.hpp for the ready ones.
+/// \tparam KeyOfType key extractor of elements.
 ////////////////////////////////////////////////////////////////////////////////
-template <typename TapeType>
+template <typename TapeType, typename Compare = std::less<>,
+          typename KeyOfType = KeyOf<TapeType>>
 class TapeSorter {
  public:
   //////////////////////////////////////////////////////////////////////////////
@@ -26,97 +60,283 @@ class TapeSorter {
   //////////////////////////////////////////////////////////////////////////////
   TapeSorter(Tape<TapeType> &tape_in, Tape<TapeType> &tape_out);
 
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief TapeSorter constructor. Throws std::invalid_argument if the
+  /// options count elements other than records with integer payloads.
+  ///
+  /// \param tape_in tape that needs to be sorted.
+  /// \param tape_out tape in which the sorted tape will be recorded.
+  /// \param options sorting options.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeSorter(Tape<TapeType> &tape_in, Tape<TapeType> &tape_out,
+             const SorterOptions &options);
+
   //////////////////////////////////////////////////////////////////////////////
   /// \brief TapeSorter destractor.
   //////////////////////////////////////////////////////////////////////////////
   ~TapeSorter() = default;
 
   //////////////////////////////////////////////////////////////////////////////
-  /// \brief Launch sorting the tape.
+  /// \brief Launch sorting the tape. Operations are counted by the counters
+  /// attached to the context of the input tape, if any.
+  ///
+  /// \return times of the phases and numbers of operations of the sort.
+  //////////////////////////////////////////////////////////////////////////////
+  SortStats Sort();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of runs merged at once by the last sort.
+  ///
+  /// \return merge fan-in.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetFanIn() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of sorted runs made by the last sort before
+  /// merging.
+  ///
+  /// \return number of runs.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetRunsNumber() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of merge passes made by the last sort.
+  ///
+  /// \return number of merge passes.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] ChunksNumber GetMergePassesNumber() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Make the plan of sorting the tape without sorting it. The number
+  /// of runs made by replacement selection is expected for random input.
+  ///
+  /// \return plan of the sort.
   //////////////////////////////////////////////////////////////////////////////
-  void Sort();
+  [[nodiscard]] SortPlan MakePlan() const;
 
  private:
   //////////////////////////////////////////////////////////////////////////////
-  /// \brief Launch splitting tapes into array of tapes.
+  /// \brief Order of elements by their keys.
+  //////////////////////////////////////////////////////////////////////////////
+  using Less = KeyLess<KeyOfType, Compare>;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Writer of runs combining the elements with equivalent keys.
+  //////////////////////////////////////////////////////////////////////////////
+  using RunWriter = AggregatingWriter<TapeType, Less>;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Element of the heap of replacement selection: the run of the
+  /// element, its number in the input tape if the order of equal keys is
+  /// kept, and the element.
+  //////////////////////////////////////////////////////////////////////////////
+  using HeapElement =
+      std::conditional_t<kIsStableOrder<KeyOfType, Compare>,
+                         std::tuple<ChunksNumber, TapeSize, TapeType>,
+                         std::pair<ChunksNumber, TapeType>>;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Sort the tape and time the phases.
   ///
-  /// \param path file path where the tapes should be stored.
-  /// \param tapes split tapes.
+  /// \param stats statistics of the sort.
   //////////////////////////////////////////////////////////////////////////////
-  void Split(std::filesystem::path &path, std::vector<Tape<TapeType>> &tapes);
+  void SortTape(SortStats &stats);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the values of the counters attached to the context of the
+  /// input tape. Without them all values are zero.
+  ///
+  /// \return numbers of operations.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] OperationCounts GetOperationCounts() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Plan the polyphase merge: choose the number of physical tapes,
+  /// up to the one of the options and to the fan-in the memory allows, with
+  /// the cheapest merge by the cost model.
+  ///
+  /// \param plan plan of the sort.
+  //////////////////////////////////////////////////////////////////////////////
+  void PlanMergeTapes(SortPlan &plan) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Make the path of a temporary tape and count the tape.
+  ///
+  /// \param dir directory of the temporary tape.
+  /// \param number number of the tape in the directory.
+  /// \return path of the temporary tape.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::filesystem::path MakeTmpTapePath(
+      const std::filesystem::path &dir, std::size_t number) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Launch splitting the input tape into sorted runs.
+  ///
+  /// \param runs storage of the runs.
+  //////////////////////////////////////////////////////////////////////////////
+  void Split(RunStore<TapeType> &runs);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Split the input tape into runs by replacement selection. A heap
+  /// of one chunk of elements outputs its minimum to the current run; a new
+  /// element smaller than the last output one waits for the next run.
+  ///
+  /// \param runs storage of the runs.
+  //////////////////////////////////////////////////////////////////////////////
+  void SplitByReplacementSelection(RunStore<TapeType> &runs);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Split the input tape into sorted runs with a pipeline: this thread
+  /// reads blocks, a thread pool sorts them, a writer thread writes them in
+  /// order. The blocks in flight share the memory left by the input tape;
+  /// their buffers are allocated once per slot and recycled through a free
+  /// list. If either thread throws, both stop and the first error is
+  /// rethrown.
+  ///
+  /// \param runs storage of the runs.
+  //////////////////////////////////////////////////////////////////////////////
+  void SplitInParallel(RunStore<TapeType> &runs);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Read the next chunk of the input tape and sort it in its buffer.
+  /// The buffer should be returned to the input tape for the next chunk.
+  ///
+  /// \return sorted chunk.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] BudgetVector<TapeType> ReadSortedChunk();
 
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Create a new split tape.
   ///
-  /// \param path path to the file where new tape will be located.
+  /// \param file path to the file where new tape will be located.
+  /// \param format format of the file of the new tape.
   /// \param tape new tape.
-  /// \param tape_number number of new tape.
   //////////////////////////////////////////////////////////////////////////////
-  void MakeSplitTape(std::filesystem::path &path, Tape<TapeType> &tape,
-                     ChunksNumber tape_number);
+  void MakeSplitTape(const std::filesystem::path &file, TapeFormat format,
+                     Tape<TapeType> &tape);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Merge groups of fan_in runs into longer runs. A group consisting
+  /// of one run is carried over. Up to merges_number groups are merged
+  /// concurrently.
+  ///
+  /// \param pass number of the merge pass.
+  /// \param runs sorted runs.
+  /// \param fan_in number of runs in a group.
+  /// \param block_size size of the buffer of each merged run.
+  /// \param merges_number number of merges sharing the memory.
+  //////////////////////////////////////////////////////////////////////////////
+  void MergePass(ChunksNumber pass, std::vector<Tape<TapeType>> &runs,
+                 ChunksNumber fan_in, ChunkSize block_size,
+                 ChunksNumber merges_number);
 
   //////////////////////////////////////////////////////////////////////////////
-  /// \brief Starting of the assembly of split tapes together.
+  /// \brief Merge the runs of physical tapes by the phases of a polyphase
+  /// merge, the last phase into the output tape. At the end of a phase its
+  /// output tape and the emptied input tape are rewound, unless the tapes are
+  /// read backward.
   ///
-  /// \param dir
-  /// \param tapes split tapes
+  /// \param runs runs written to the physical tapes.
+  /// \param stats statistics of the sort.
   //////////////////////////////////////////////////////////////////////////////
-  void Assembly(ChunksNumber dir, std::vector<Tape<TapeType>> &tapes);
+  void MergeOnTapes(RunStore<TapeType> &runs, SortStats &stats);
 
   //////////////////////////////////////////////////////////////////////////////
-  /// \brief Merge two sorted tapes into one sorted tape.
+  /// \brief Merge a run of every physical tape with a loser tree. The head of
+  /// a tape is left on the first element of its next run.
   ///
-  /// \param path path to the file of new tape file to which the result is
-  /// written.
-  /// \param tape0 first sorted tape.
-  /// \param tape1 second sorted tape.
-  /// \return sorted tape consisting of two introductory tapes.
+  /// \param readers readers of the tapes.
+  /// \param run_sizes sizes of the merged runs by tapes.
+  /// \param writer writer of the result.
   //////////////////////////////////////////////////////////////////////////////
-  static Tape<TapeType> Merge(std::filesystem::path path, Tape<TapeType> &tape0,
-                              Tape<TapeType> &tape1);
+  void MergeTapeRuns(std::vector<std::optional<Tape<TapeType>>> &readers,
+                     const std::vector<TapeSize> &run_sizes,
+                     RunWriter &writer) const;
 
   //////////////////////////////////////////////////////////////////////////////
-  /// \brief Create new sorted chunk from two tapes by merging.
+  /// \brief Merge a run of every physical tape read backward with a loser
+  /// tree. The elements of a run come reversed, so the order of the merge is
+  /// the one they come in.
   ///
-  /// \param tape_result writing a new chunk to this tape.
-  /// \param tape0 first sorted resource tape.
-  /// \param tape1 second sorted resource tape.
-  /// \param end0 true if the position on the tape0 is the rightmost and the
-  /// tape1 is passed to the end.
-  /// \param end1 true if the position on the tape1 is the rightmost and the
-  /// tape2 is passed to the end.
-  /// \param size size of new chunk.
-  /// \return new value of end1 and end2 params.
-  //////////////////////////////////////////////////////////////////////////////
-  static std::pair<bool, bool> MergeOneChunk(Tape<TapeType> &tape_result,
-                                             Tape<TapeType> &tape0,
-                                             Tape<TapeType> &tape1, bool end0,
-                                             bool end1, ChunkSize size);
-
-  //////////////////////////////////////////////////////////////////////////////
-  /// \brief Put the remaining numbers of the tape in the buffer.
+  /// \tparam Order order of the elements as they come.
+  /// \param readers readers of the tapes.
+  /// \param blocks elements of the current chunks of the readers not taken
+  /// yet.
+  /// \param run_sizes sizes of the merged runs by tapes.
+  /// \param writer writer of the result.
+  //////////////////////////////////////////////////////////////////////////////
+  template <typename Order>
+  void MergeTapeRunsBackward(
+      std::vector<std::optional<Tape<TapeType>>> &readers,
+      std::vector<std::span<const TapeType>> &blocks,
+      const std::vector<TapeSize> &run_sizes, RunWriter &writer) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Merge several sorted runs into one sorted tape with a loser tree.
+  /// Two runs read by chunks are merged by MergeTwoRuns.
+  ///
+  /// \param path path to the file of new tape to which the result is written.
+  /// \param format format of the file of new tape.
+  /// \param runs sorted runs.
+  /// \param block_size size of the buffer of each merged run and of the
+  /// output buffer. With prefetching each run gets two buffers of half the
+  /// size.
+  /// \return sorted tape consisting of all runs.
+  //////////////////////////////////////////////////////////////////////////////
+  Tape<TapeType> MergeRuns(const std::filesystem::path &path,
+                           TapeFormat format, std::span<Tape<TapeType>> runs,
+                           ChunkSize block_size) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Merge two sorted runs chunk by chunk. The chunks are merged by
+  /// MergeBlocks straight from the buffers of the runs, and the rest of the
+  /// run left last is written a chunk at a time, so the tapes are accessed
+  /// only at chunk boundaries.
+  ///
+  /// \param path path to the file of new tape to which the result is written.
+  /// \param format format of the file of new tape.
+  /// \param runs two sorted runs.
+  /// \param block_size size of the buffer of each merged run and of the
+  /// output buffer.
+  /// \return sorted tape consisting of both runs.
+  //////////////////////////////////////////////////////////////////////////////
+  Tape<TapeType> MergeTwoRuns(const std::filesystem::path &path,
+                              TapeFormat format,
+                              std::span<Tape<TapeType>> runs,
+                              ChunkSize block_size) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Copy elements from a tape to a writer block by block. It drains
+  /// the last run of a merge once the others are exhausted.
+  ///
+  /// \param from tape whose magnetic head points to the first copied element.
+  /// \param count number of copied elements.
+  /// \param to writer of the result.
+  /// \param block_size size of the copy buffer.
+  //////////////////////////////////////////////////////////////////////////////
+  void CopyBlocks(ITape<TapeType> &from, TapeSize count, RunWriter &to,
+                  ChunkSize block_size) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Open a run for reading by the merge: a memory-mapped tape for
+  /// binary runs if the options ask for it, otherwise a tape of chunks.
   ///
-  /// \param tape tape from which the current number is taken.
-  /// \param buffer buffer of numbers.
-  /// \param size size that the buffer should have.
+  /// \param run sorted run.
+  /// \param block_size size of the buffer of the run.
+  /// \return reader of the run.
   //////////////////////////////////////////////////////////////////////////////
-  static void PutTapeRestToBuffer(Tape<TapeType> &tape,
-                                  std::vector<TapeType> &buffer,
-                                  ChunkSize size);
+  std::unique_ptr<ITape<TapeType>> OpenRunReader(Tape<TapeType> &run,
+                                                 ChunkSize block_size) const;
 
   //////////////////////////////////////////////////////////////////////////////
-  /// \brief Put the current element from the tape (indicated by the magnetic
-  /// head) in the buffer.
+  /// \brief Open a run for reading by chunks. With prefetching the buffer is
+  /// shared by two chunks of half the size.
   ///
-  /// \param tape tape from which the current number is taken.
-  /// \param buffer buffer of numbers.
-  /// \param end true if the magnetic head points to the rightmost position of
-  /// the tape else false.
-  /// \return true if the magnetic head points to the rightmost position of the
-  /// tape else false.
+  /// \param run sorted run.
+  /// \param block_size size of the buffer of the run.
+  /// \return tape of the run.
   //////////////////////////////////////////////////////////////////////////////
-  bool static PutElementInBuffer(Tape<TapeType> &tape,
-                                 std::vector<TapeType> &buffer, bool &end);
+  Tape<TapeType> OpenRunTape(Tape<TapeType> &run, ChunkSize block_size) const;
 
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Tape that needs to be sorted.
@@ -127,192 +347,893 @@ class TapeSorter {
   //////////////////////////////////////////////////////////////////////////////
   Tape<TapeType> tape_out_;
 
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Sorting options.
+  //////////////////////////////////////////////////////////////////////////////
+  SorterOptions options_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Planner of the memory of the split and of the merge.
+  //////////////////////////////////////////////////////////////////////////////
+  MemoryPlanner<TapeType> planner_{};
+
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Directory for storing temporary tapes.
   //////////////////////////////////////////////////////////////////////////////
   const std::filesystem::path dir_for_tmp_tapes_ = "./tmp";
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Format of temporary tapes.
+  //////////////////////////////////////////////////////////////////////////////
+  static constexpr TapeFormat kTmpTapesFormat = TapeFormat::kBinary;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of runs made by the last sort.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunksNumber runs_number_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of runs merged at once by the last sort.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunksNumber fan_in_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of merge passes made by the last sort.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunksNumber merge_passes_number_{};
 };
 
-template <typename TapeType>
-TapeSorter<TapeType>::TapeSorter(Tape<TapeType> &tape_in,
-                                 Tape<TapeType> &tape_out)
-    : tape_in_(tape_in), tape_out_(tape_out) {}
+template <typename TapeType, typename Compare, typename KeyOfType>
+TapeSorter<TapeType, Compare, KeyOfType>::TapeSorter(
+    Tape<TapeType> &tape_in, Tape<TapeType> &tape_out)
+    : tape_in_(tape_in),
+      tape_out_(tape_out),
+      planner_(tape_in.GetMemorySize(), options_,
+               kIsStableOrder<KeyOfType, Compare>) {}
+
+template <typename TapeType, typename Compare, typename KeyOfType>
+TapeSorter<TapeType, Compare, KeyOfType>::TapeSorter(
+    Tape<TapeType> &tape_in, Tape<TapeType> &tape_out,
+    const SorterOptions &options)
+    : tape_in_(tape_in),
+      tape_out_(tape_out),
+      options_(options),
+      planner_(tape_in.GetMemorySize(), options,
+               kIsStableOrder<KeyOfType, Compare>) {
+  if (options_.aggregation_ == Aggregation::kCount &&
+      !kIsCountRecord<TapeType>) {
+    throw std::invalid_argument(
+        "Only records with integer payloads are counted");
+  }
+}
+
+template <typename TapeType, typename Compare, typename KeyOfType>
+SortStats TapeSorter<TapeType, Compare, KeyOfType>::Sort() {
+  SortStats stats;
+  OperationCounts counts = GetOperationCounts();
+  SortTape(stats);
+  OperationCounts sorted_counts = GetOperationCounts();
+  for (std::size_t i = 0; i < kTapeCountersNumber; i++) {
+    stats.counts_[i] = sorted_counts[i] - counts[i];
+  }
+  return stats;
+}
 
-template <typename TapeType>
-void TapeSorter<TapeType>::Sort() {
+template <typename TapeType, typename Compare, typename KeyOfType>
+void TapeSorter<TapeType, Compare, KeyOfType>::SortTape(SortStats &stats) {
+  runs_number_ = 0;
+  fan_in_ = 0;
+  merge_passes_number_ = 0;
   if (!tape_in_.GetSize()) {
     return;
   }
-  std::filesystem::create_directories(dir_for_tmp_tapes_);
-  std::filesystem::path tmp_path(dir_for_tmp_tapes_);
-  ChunksNumber chunks_number = tape_in_.GetChunksNumber();
-
-  std::vector<Tape<TapeType>> tapes(chunks_number,
-                                    Tape<TapeType>{tape_in_.delays_});
+  PhaseTimer split_timer("split");
+  if (tape_in_.context_.budget_) {
+    // Memory taken by other sorts sharing the budget is not planned.
+    planner_ = MemoryPlanner<TapeType>(
+        std::min<MemorySize>(tape_in_.GetMemorySize(),
+                             tape_in_.context_.budget_->GetAvailable()),
+        options_, kIsStableOrder<KeyOfType, Compare>);
+  }
+  tape_in_.SetMaxChunkSize(planner_.GetSplitChunkSize());
+  if (tape_in_.GetChunksNumber() == 1) {
+    Tape<TapeType> result{tape_in_.context_};
+    MakeSplitTape(tape_out_.GetTapeFilePath(), tape_out_.GetFormat(), result);
+    tape_out_ = std::move(result);
+    runs_number_ = 1;
+    stats.phases_.push_back(split_timer.Stop());
+    return;
+  }
 
-  Split(tmp_path, tapes);
+  tape_in_.SetPrefetch(options_.prefetch_);
+  SortPlan plan = options_.merge_tapes_ ? MakePlan() : SortPlan{};
+  std::filesystem::path tmp_path(dir_for_tmp_tapes_);
+  tmp_path += plan.merge_tapes_ ? "/" : "/" + std::to_string(0) + "/";
+  std::filesystem::create_directories(tmp_path);
+  RunStore<TapeType> runs{tmp_path, tape_in_.context_, kTmpTapesFormat,
+                          plan.merge_tapes_, plan.read_backward_};
 
-  if (chunks_number == 1) {
-    tape_out_ = std::move(tapes[0]);
-  } else {
-    for (ChunksNumber i = chunks_number, j = 1; i != 2;
-         i = (i - 1) / 2 + 1, j++) {
-      Assembly(j, tapes);
-      std::filesystem::path prev(dir_for_tmp_tapes_);
-      prev += "/" + std::to_string(j - 1) + "/";
-      std::filesystem::remove_all(prev);
+  Split(runs);
+  runs.Close();
+  // The merge plans the whole memory, the input tape buffers are not needed.
+  tape_in_.SetPrefetch(false);
+  tape_in_.ClearChunkInTape();
+  runs_number_ = runs.GetRunsNumber();
+  if (runs.IsPolyphase()) {
+    // The written tapes are rewound before the merge, unless they are read
+    // backward from where they end.
+    PolyphaseMerge &schedule = runs.GetSchedule();
+    for (ChunksNumber tape = 0;
+         tape < plan.merge_tapes_ && !plan.read_backward_; tape++) {
+      tape_in_.context_.WaitForShift(schedule.GetTapeSize(tape));
     }
+    stats.phases_.push_back(split_timer.Stop());
+    MergeOnTapes(runs, stats);
+    std::filesystem::remove_all(dir_for_tmp_tapes_);
+    return;
+  }
+  stats.phases_.push_back(split_timer.Stop());
 
-    tape_out_ =
-        std::move(Merge(tape_out_.GetTapeFilePath(), tapes[0], tapes[1]));
+  std::vector<Tape<TapeType>> tapes = runs.TakeRuns();
+  fan_in_ = planner_.GetFanIn(runs_number_);
+  ChunkSize block_size = planner_.GetMergeBlockSize(fan_in_);
+  ChunksNumber merges_number = planner_.GetMergesNumber();
+  ChunksNumber pass_fan_in = planner_.GetFanIn(runs_number_, merges_number);
+  ChunkSize pass_block_size =
+      planner_.GetMergeBlockSize(pass_fan_in, merges_number);
+  while (tapes.size() > fan_in_) {
+    PhaseTimer pass_timer("merge pass " +
+                          std::to_string(merge_passes_number_ + 1));
+    MergePass(++merge_passes_number_, tapes, pass_fan_in, pass_block_size,
+              merges_number);
+    stats.phases_.push_back(pass_timer.Stop());
   }
+
+  PhaseTimer merge_timer("final merge");
+  tape_out_ = MergeRuns(tape_out_.GetTapeFilePath(), tape_out_.GetFormat(),
+                        tapes, block_size);
+  merge_passes_number_++;
+  stats.phases_.push_back(merge_timer.Stop());
   std::filesystem::remove_all(dir_for_tmp_tapes_);
 }
 
-template <typename TapeType>
-void TapeSorter<TapeType>::Split(std::filesystem::path &path,
-                                 std::vector<Tape<TapeType>> &tapes) {
-  path += "/" + std::to_string(0) + "/";
-  std::filesystem::create_directories(path);
-  ChunksNumber chunks_number = tape_in_.GetChunksNumber();
-  for (ChunksNumber i = 0; i < chunks_number; i++) {
-    MakeSplitTape(path, tapes[i], i);
+template <typename TapeType, typename Compare, typename KeyOfType>
+OperationCounts TapeSorter<TapeType, Compare, KeyOfType>::GetOperationCounts()
+    const {
+#ifdef TAPE_SORTER_STATS
+  if (tape_in_.context_.counters_) {
+    return tape_in_.context_.counters_->GetCounts();
   }
+#endif
+  return {};
 }
 
-template <typename TapeType>
-void TapeSorter<TapeType>::Assembly(ChunksNumber dir,
-                                    std::vector<Tape<TapeType>> &tapes) {
-  std::filesystem::path curr_path(dir_for_tmp_tapes_);
-  curr_path += "/" + std::to_string(dir) + "/";
-  std::filesystem::create_directories(curr_path);
+template <typename TapeType, typename Compare, typename KeyOfType>
+std::filesystem::path TapeSorter<TapeType, Compare, KeyOfType>::MakeTmpTapePath(
+    const std::filesystem::path &dir, std::size_t number) const {
+  std::filesystem::path tmp_file = dir;
+  tmp_file += std::to_string(number) + ".bin";
+  tape_in_.context_.Count(TapeCounter::kTempFiles);
+  return tmp_file;
+}
 
-  TapeSize tapes_size = tapes.size();
-  std::vector<Tape<TapeType>> new_tapes(
-      tapes_size % 2 == 0 ? tapes_size / 2 : (tapes_size / 2 + 1));
-  TapeSize i = 0;
-  for (TapeSize j = 0; i < tapes_size / 2; i++, j += 2) {
-    std::filesystem::path tmp_file = curr_path;
-    tmp_file += std::to_string(i) + ".txt";
-    new_tapes[i] = std::move(Merge(tmp_file, tapes[j], tapes[j + 1]));
-  }
-  if (tapes_size % 2 != 0) {
-    std::filesystem::path tmp_file = curr_path;
-    tmp_file += std::to_string(i) + ".txt";
-    std::fstream stream_out(tmp_file, std::fstream::out);
-    Tape<TapeType> curr_tape{tapes[tapes_size - 1], tmp_file};
-    new_tapes[new_tapes.size() - 1] = curr_tape;
-  }
-  tapes.clear();
-  tapes = new_tapes;
+template <typename TapeType, typename Compare, typename KeyOfType>
+ChunksNumber TapeSorter<TapeType, Compare, KeyOfType>::GetFanIn() const {
+  return fan_in_;
 }
 
-template <typename TapeType>
-void TapeSorter<TapeType>::MakeSplitTape(std::filesystem::path &path,
-                                         Tape<TapeType> &tape,
-                                         ChunksNumber tape_number) {
-  std::filesystem::path tmp_file = path;
-  tmp_file += std::to_string(tape_number) + ".txt";
-  std::fstream stream_to(tmp_file, std::fstream::out);
+template <typename TapeType, typename Compare, typename KeyOfType>
+ChunksNumber TapeSorter<TapeType, Compare, KeyOfType>::GetRunsNumber() const {
+  return runs_number_;
+}
 
-  tape_in_.ReadChunkToTheRight();
+template <typename TapeType, typename Compare, typename KeyOfType>
+ChunksNumber TapeSorter<TapeType, Compare, KeyOfType>::GetMergePassesNumber()
+    const {
+  return merge_passes_number_;
+}
 
-  std::vector<TapeType> buffer = tape_in_.GetChunkElements();
-  std::sort(buffer.begin(), buffer.end());
+template <typename TapeType, typename Compare, typename KeyOfType>
+SortPlan TapeSorter<TapeType, Compare, KeyOfType>::MakePlan() const {
+  SortPlan plan;
+  plan.elements_number_ = tape_in_.GetSize();
+  plan.chunk_size_ =
+      std::min<ChunkSize>(planner_.GetSplitChunkSize(), plan.elements_number_);
+  plan.mapped_merge_ = options_.mapped_merge_;
+  if (!plan.elements_number_) {
+    return plan;
+  }
+  if (plan.chunk_size_ == plan.elements_number_) {
+    plan.split_access_ = SplitAccess::kSingleChunk;
+    plan.runs_number_ = 1;
+    return plan;
+  }
 
-  for (TapeType &element : buffer) {
-    stream_to << element << ' ';
+  if (options_.run_generation_ == RunGeneration::kReplacementSelection) {
+    plan.split_access_ = SplitAccess::kCells;
+    plan.runs_number_ =
+        (plan.elements_number_ - 1) /
+            (2 * planner_.template GetHeapSize<HeapElement>()) +
+        1;
+  } else if (options_.threads_ > 1) {
+    plan.split_access_ = SplitAccess::kCells;
+    plan.runs_number_ =
+        (plan.elements_number_ - 1) / planner_.GetSplitBlockSize() + 1;
+  } else {
+    plan.split_access_ = SplitAccess::kChunks;
+    plan.runs_number_ = (plan.elements_number_ - 1) / plan.chunk_size_ + 1;
   }
 
-  stream_to.close();
-  Tape<TapeType> result_tape{tmp_file, static_cast<TapeSize>(buffer.size()),
-                             static_cast<ChunkSize>(buffer.size())};
-  tape = std::move(result_tape);
+  ChunkSize reader_divisor =
+      options_.prefetch_ && !options_.mapped_merge_ ? 2 : 1;
+  plan.fan_in_ = planner_.GetFanIn(plan.runs_number_);
+  plan.read_block_size_ = std::max<ChunkSize>(
+      planner_.GetMergeBlockSize(plan.fan_in_) / reader_divisor, 1);
+  ChunksNumber merges_number = planner_.GetMergesNumber();
+  plan.pass_fan_in_ = planner_.GetFanIn(plan.runs_number_, merges_number);
+  plan.pass_read_block_size_ = std::max<ChunkSize>(
+      planner_.GetMergeBlockSize(plan.pass_fan_in_, merges_number) /
+          reader_divisor,
+      1);
+  // A polyphase merge takes runs of several tapes in no order of the input
+  // tape, so equal keys are kept in order by a temporary tape per run.
+  if (options_.merge_tapes_ && !kIsStableOrder<KeyOfType, Compare>) {
+    plan.read_backward_ =
+        options_.read_backward_ &&
+        options_.run_generation_ != RunGeneration::kReplacementSelection;
+    PlanMergeTapes(plan);
+  }
+  return plan;
+}
+
+template <typename TapeType, typename Compare, typename KeyOfType>
+void TapeSorter<TapeType, Compare, KeyOfType>::PlanMergeTapes(
+    SortPlan &plan) const {
+  // Runs on physical tapes are read by chunks, and merged by one thread.
+  // Tapes read backward are not prefetched.
+  ChunkSize reader_divisor =
+      options_.prefetch_ && !plan.read_backward_ ? 2 : 1;
+  ChunksNumber max_tapes = std::min<ChunksNumber>(
+      options_.merge_tapes_,
+      planner_.GetFanIn(MemoryPlanner<TapeType>::kMaxFanIn) + 1);
+  CostModel model(tape_in_.context_.delays_);
+  plan.mapped_merge_ = false;
+  plan.merge_tapes_ = options_.merge_tapes_;
+
+  // More tapes make fewer phases but smaller buffers and more dummy runs.
+  std::optional<std::pair<std::chrono::milliseconds, uint64_t>> best_cost;
+  SortPlan best_plan = plan;
+  for (ChunksNumber tapes = 3; tapes <= max_tapes; tapes++) {
+    plan.merge_tapes_ = tapes;
+    plan.fan_in_ = tapes - 1;
+    plan.pass_fan_in_ = plan.fan_in_;
+    plan.read_block_size_ = std::max<ChunkSize>(
+        planner_.GetMergeBlockSize(plan.fan_in_) / reader_divisor, 1);
+    plan.pass_read_block_size_ = plan.read_block_size_;
+
+    SortCost cost = model.Estimate(plan);
+    uint64_t operations = 0;
+    for (const PhaseCost &phase : cost.phases_) {
+      operations += phase.reads_ + phase.writes_ + phase.shifts_;
+    }
+    // Without delays the tapes are chosen by the number of operations.
+    std::pair<std::chrono::milliseconds, uint64_t> tapes_cost{cost.time_,
+                                                              operations};
+    if (!best_cost || tapes_cost < *best_cost) {
+      best_cost = tapes_cost;
+      best_plan = plan;
+    }
+  }
+  plan = best_plan;
+}
+
+template <typename TapeType, typename Compare, typename KeyOfType>
+void TapeSorter<TapeType, Compare, KeyOfType>::Split(RunStore<TapeType> &runs) {
+  if (options_.run_generation_ == RunGeneration::kReplacementSelection) {
+    SplitByReplacementSelection(runs);
+    return;
+  }
+  if (options_.threads_ > 1) {
+    SplitInParallel(runs);
+    return;
+  }
+
+  ChunksNumber chunks_number = tape_in_.GetChunksNumber();
+  runs.PlanRuns(chunks_number);
+  for (ChunksNumber i = 0; i < chunks_number; i++) {
+    BudgetVector<TapeType> buffer = ReadSortedChunk();
+    std::span<const TapeType> run(buffer.data(),
+                                  CombineRun<Less>(options_.aggregation_,
+                                                   std::span<TapeType>(buffer)));
+    if (runs.IsNextRunDescending()) {
+      std::reverse(buffer.begin(), buffer.begin() + run.size());
+    }
+    // The sorted chunk is written at once, the writer does not buffer it.
+    runs.StartRun(static_cast<ChunkSize>(run.size())).WriteChunk(run);
+    runs.EndRun();
+    // The next chunk is read into the same buffer.
+    tape_in_.ReturnChunkElements(std::move(buffer));
+  }
 }
 
-template <typename TapeType>
-Tape<TapeType> TapeSorter<TapeType>::Merge(std::filesystem::path path,
-                                           Tape<TapeType> &tape0,
-                                           Tape<TapeType> &tape1) {
-  std::pair<bool, bool> check_ends = {false, false};
+template <typename TapeType, typename Compare, typename KeyOfType>
+void TapeSorter<TapeType, Compare, KeyOfType>::SplitByReplacementSelection(
+    RunStore<TapeType> &runs) {
+  constexpr std::size_t kElement = std::tuple_size_v<HeapElement> - 1;
+  // The heap outputs the element of the first run with the smallest key, of
+  // equal keys the one read first.
+  auto heap_compare = [](const HeapElement &lhs, const HeapElement &rhs) {
+    if (std::get<0>(lhs) != std::get<0>(rhs)) {
+      return std::get<0>(rhs) < std::get<0>(lhs);
+    }
+    Less less;
+    if constexpr (kIsStableOrder<KeyOfType, Compare>) {
+      if (!less(std::get<kElement>(lhs), std::get<kElement>(rhs)) &&
+          !less(std::get<kElement>(rhs), std::get<kElement>(lhs))) {
+        return std::get<1>(rhs) < std::get<1>(lhs);
+      }
+    }
+    return less(std::get<kElement>(rhs), std::get<kElement>(lhs));
+  };
+  TapeSize read_number = 0;
+  auto heap_element = [&read_number](ChunksNumber run,
+                                     const TapeType &element) {
+    if constexpr (kIsStableOrder<KeyOfType, Compare>) {
+      return HeapElement{run, read_number++, element};
+    } else {
+      return HeapElement{run, element};
+    }
+  };
+
+  ChunkSize heap_size = planner_.template GetHeapSize<HeapElement>();
+  ChunkSize buffer_size = tape_in_.GetMaxChunkSize();
+  TapeSize remaining = tape_in_.GetSize();
+  auto read_next = [this, &remaining]() {
+    TapeType element = tape_in_.ReadCell();
+    tape_in_.MoveLeft();
+    remaining--;
+    return element;
+  };
 
-  std::fstream result_file_stream(path, std::fstream::out);
-  Tape<TapeType> result_tape{path, tape0.GetSize() + tape1.GetSize(),
-                             tape0.GetMaxChunkSize()};
-  for (ChunksNumber i = 0; i < result_tape.GetChunksNumber() - 1; i++) {
-    check_ends =
-        MergeOneChunk(result_tape, tape0, tape1, check_ends.first,
-                      check_ends.second, result_tape.GetMaxChunkSize());
+  BudgetVector<HeapElement> heap{
+      BudgetAllocator<HeapElement>(tape_in_.context_.budget_)};
+  heap.reserve(heap_size);
+  while (remaining && heap.size() < heap_size) {
+    heap.push_back(heap_element(0, read_next()));
   }
-  MergeOneChunk(result_tape, tape0, tape1, check_ends.first, check_ends.second,
-                result_tape.GetMinChunkSize());
+  std::make_heap(heap.begin(), heap.end(), heap_compare);
+
+  ChunksNumber current_run = 0;
+  RunWriter writer{runs.StartRun(buffer_size), options_.aggregation_};
+
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), heap_compare);
+    ChunksNumber run = std::get<0>(heap.back());
+    TapeType element = std::get<kElement>(heap.back());
+    heap.pop_back();
 
-  result_file_stream.close();
-  tape0.ClearChunkInTape();
-  tape1.ClearChunkInTape();
+    if (run != current_run) {
+      writer.Flush();
+      runs.EndRun();
+      current_run = run;
+      writer = RunWriter{runs.StartRun(buffer_size), options_.aggregation_};
+    }
+    writer.Write(element);
 
-  return result_tape;
+    if (remaining) {
+      TapeType next = read_next();
+      heap.push_back(heap_element(Less{}(next, element) ? run + 1 : run, next));
+      std::push_heap(heap.begin(), heap.end(), heap_compare);
+    }
+  }
+  writer.Flush();
+  runs.EndRun();
 }
 
-template <typename TapeType>
-std::pair<bool, bool> TapeSorter<TapeType>::MergeOneChunk(
-    Tape<TapeType> &tape_result, Tape<TapeType> &tape0, Tape<TapeType> &tape1,
-    bool end0, bool end1, ChunkSize size) {
-  std::vector<TapeType> buffer;
-  if (end0 && !end1) {
-    PutTapeRestToBuffer(tape1, buffer, size);
-  } else if (end1 && !end0) {
-    PutTapeRestToBuffer(tape0, buffer, size);
-  } else {
-    while (buffer.size() != size) {
-      while (buffer.size() != size) {
-        if (tape0.ReadCell() < tape1.ReadCell()) {
-          if (PutElementInBuffer(tape0, buffer, end0)) {
-            break;
-          }
-        } else {
-          if (PutElementInBuffer(tape1, buffer, end1)) {
-            break;
+template <typename TapeType, typename Compare, typename KeyOfType>
+void TapeSorter<TapeType, Compare, KeyOfType>::SplitInParallel(
+    RunStore<TapeType> &runs) {
+  ChunksNumber threads_number = planner_.GetSplitThreadsNumber();
+  ChunksNumber slots_number = threads_number + 2;
+  ChunkSize block_size = planner_.GetSplitBlockSize();
+  TapeSize remaining = tape_in_.GetSize();
+  ChunksNumber blocks_number = (remaining - 1) / block_size + 1;
+  runs.PlanRuns(blocks_number);
+
+  ThreadPool pool(threads_number);
+  std::counting_semaphore<> free_slots(slots_number);
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::queue<std::future<BudgetVector<TapeType>>> sorted_blocks;
+  // Buffers of the written blocks, the next blocks are read into them.
+  std::vector<BudgetVector<TapeType>> free_blocks;
+  free_blocks.reserve(slots_number);
+  // Set by the thread that fails first: the other one stops, and the error
+  // is rethrown once the writer is joined.
+  bool stopped = false;
+  std::exception_ptr error;
+  auto stop = [&](std::exception_ptr thread_error) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!stopped) {
+        stopped = true;
+        error = std::move(thread_error);
+      }
+    }
+    ready.notify_one();
+  };
+
+  std::thread writer_thread([&]() {
+    try {
+      for (ChunksNumber i = 0; i < blocks_number; i++) {
+        std::future<BudgetVector<TapeType>> sorted_block;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          ready.wait(lock, [&sorted_blocks, &stopped]() {
+            return !sorted_blocks.empty() || stopped;
+          });
+          if (stopped) {
+            return;
           }
+          sorted_block = std::move(sorted_blocks.front());
+          sorted_blocks.pop();
+        }
+        BudgetVector<TapeType> block = sorted_block.get();
+        if (runs.IsNextRunDescending()) {
+          std::reverse(block.begin(), block.end());
+        }
+
+        runs.StartRun(static_cast<ChunkSize>(block.size())).WriteChunk(block);
+        runs.EndRun();
+
+        block.clear();
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          free_blocks.push_back(std::move(block));
         }
+        free_slots.release();
       }
-      if (buffer.size() != size) {
-        if (!end0 && end1) {
-          PutTapeRestToBuffer(tape0, buffer, size);
-        } else if (end0 && !end1) {
-          PutTapeRestToBuffer(tape1, buffer, size);
+    } catch (...) {
+      stop(std::current_exception());
+      // Wakes the reading thread if it waits for a free slot.
+      free_slots.release();
+    }
+  });
+
+  try {
+    for (ChunksNumber i = 0; i < blocks_number; i++) {
+      free_slots.acquire();
+      BudgetVector<TapeType> block(
+          BudgetAllocator<TapeType>(tape_in_.context_.budget_));
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopped) {
+          break;
+        }
+        if (!free_blocks.empty()) {
+          block = std::move(free_blocks.back());
+          free_blocks.pop_back();
         }
       }
+      // A slot allocates its buffer for the largest block once.
+      block.reserve(block_size);
+      block.resize(std::min<TapeSize>(block_size, remaining));
+      for (TapeType &element : block) {
+        element = tape_in_.ReadCell();
+        tape_in_.MoveLeft();
+      }
+      remaining -= block.size();
+
+      std::future<BudgetVector<TapeType>> sorted_block =
+          pool.Submit([block = std::move(block),
+                       aggregation = options_.aggregation_,
+                       budget = tape_in_.context_.budget_]() mutable {
+            SortRun<TapeType, KeyOfType, Compare>(block, budget);
+            block.resize(CombineRun<Less>(aggregation, std::span(block)));
+            return std::move(block);
+          });
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        sorted_blocks.push(std::move(sorted_block));
+      }
+      ready.notify_one();
+    }
+  } catch (...) {
+    stop(std::current_exception());
+  }
+  writer_thread.join();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+template <typename TapeType, typename Compare, typename KeyOfType>
+BudgetVector<TapeType>
+TapeSorter<TapeType, Compare, KeyOfType>::ReadSortedChunk() {
+  tape_in_.ReadChunkToTheRight();
+
+  BudgetVector<TapeType> buffer = tape_in_.TakeChunkElements();
+  SortRun<TapeType, KeyOfType, Compare>(buffer, tape_in_.context_.budget_);
+  return buffer;
+}
+
+template <typename TapeType, typename Compare, typename KeyOfType>
+void TapeSorter<TapeType, Compare, KeyOfType>::MakeSplitTape(
+    const std::filesystem::path &file, TapeFormat format,
+    Tape<TapeType> &tape) {
+  BudgetVector<TapeType> buffer = ReadSortedChunk();
+  auto size = static_cast<ChunkSize>(
+      CombineRun<Less>(options_.aggregation_, std::span<TapeType>(buffer)));
+
+  // The sorted chunk is written at once, the writer does not buffer it.
+  TapeWriter<TapeType> writer{file, 1, tape_in_.context_, format};
+  writer.WriteChunk(std::span<const TapeType>(buffer).first(size));
+  writer.Close();
+
+  // The next chunk is read into the same buffer.
+  tape_in_.ReturnChunkElements(std::move(buffer));
+
+  Tape<TapeType> result_tape{file, size, size, format, tape_in_.context_};
+  tape = std::move(result_tape);
+}
+
+template <typename TapeType, typename Compare, typename KeyOfType>
+void TapeSorter<TapeType, Compare, KeyOfType>::MergePass(
+    ChunksNumber pass, std::vector<Tape<TapeType>> &runs, ChunksNumber fan_in,
+    ChunkSize block_size, ChunksNumber merges_number) {
+  std::filesystem::path curr_path(dir_for_tmp_tapes_);
+  curr_path += "/" + std::to_string(pass) + "/";
+  std::filesystem::create_directories(curr_path);
+
+  std::vector<Tape<TapeType>> new_runs((runs.size() - 1) / fan_in + 1);
+  auto merge_group = [&](std::size_t group) {
+    std::size_t first = group * fan_in;
+    std::size_t count = std::min<std::size_t>(fan_in, runs.size() - first);
+    if (count == 1) {
+      new_runs[group] = std::move(runs[first]);
+      return;
+    }
+
+    std::filesystem::path tmp_file = MakeTmpTapePath(curr_path, group);
+    std::span<Tape<TapeType>> runs_group(runs.data() + first, count);
+    new_runs[group] =
+        MergeRuns(tmp_file, kTmpTapesFormat, runs_group, block_size);
+    for (Tape<TapeType> &run : runs_group) {
+      std::filesystem::remove(run.GetTapeFilePath());
+    }
+  };
+
+  if (merges_number > 1 && new_runs.size() > 1) {
+    ThreadPool pool(std::min<std::size_t>(merges_number, new_runs.size()));
+    std::vector<std::future<void>> merged;
+    merged.reserve(new_runs.size());
+    for (std::size_t group = 0; group < new_runs.size(); group++) {
+      merged.push_back(pool.Submit([&merge_group, group]() {
+        merge_group(group);
+      }));
+    }
+    for (std::future<void> &group_merged : merged) {
+      group_merged.get();
+    }
+  } else {
+    for (std::size_t group = 0; group < new_runs.size(); group++) {
+      merge_group(group);
+    }
+  }
+  runs = std::move(new_runs);
+}
+
+template <typename TapeType, typename Compare, typename KeyOfType>
+void TapeSorter<TapeType, Compare, KeyOfType>::MergeOnTapes(
+    RunStore<TapeType> &runs, SortStats &stats) {
+  PolyphaseMerge &schedule = runs.GetSchedule();
+  ChunksNumber tapes_number = schedule.GetTapesNumber();
+  fan_in_ = tapes_number - 1;
+  ChunkSize block_size = planner_.GetMergeBlockSize(fan_in_);
+  bool read_backward = schedule.IsReadBackward();
+
+  std::vector<std::optional<Tape<TapeType>>> readers(tapes_number);
+  std::vector<std::span<const TapeType>> blocks(tapes_number);
+  auto open_reader = [&](ChunksNumber tape) {
+    readers[tape].reset();
+    blocks[tape] = {};
+    TapeSize size = schedule.GetTapeSize(tape);
+    if (size) {
+      Tape<TapeType> written{runs.GetTapePath(tape), size,
+                             std::min<ChunkSize>(block_size, size),
+                             kTmpTapesFormat, tape_in_.context_};
+      if (read_backward) {
+        readers[tape].emplace(std::move(written));
+      } else {
+        readers[tape].emplace(OpenRunTape(written, block_size));
+      }
+    }
+  };
+  for (ChunksNumber tape = 0; tape < tapes_number; tape++) {
+    if (tape != schedule.GetOutputTape()) {
+      open_reader(tape);
+    }
+  }
+
+  TapeSize output_size = 0;
+  while (schedule.GetPhasesNumber()) {
+    bool last = schedule.GetPhasesNumber() == 1;
+    PhaseTimer phase_timer(
+        last ? "final merge"
+             : "merge pass " + std::to_string(merge_passes_number_ + 1));
+    merge_passes_number_++;
+
+    ChunksNumber output = schedule.GetOutputTape();
+    std::filesystem::path path = runs.GetTapePath(output);
+    TapeFormat format = kTmpTapesFormat;
+    if (last) {
+      path = tape_out_.GetTapeFilePath();
+      format = tape_out_.GetFormat();
+    } else if (!std::filesystem::exists(path)) {
+      tape_in_.context_.Count(TapeCounter::kTempFiles);
+    }
+    TapeWriter<TapeType> writer{path, block_size, tape_in_.context_, format};
+    RunWriter run_writer{writer, options_.aggregation_};
+    for (ChunksNumber merges = schedule.GetMergesNumber(); merges; merges--) {
+      bool descending = read_backward && schedule.IsNextMergeDescending();
+      std::vector<TapeSize> merge = schedule.TakeMerge();
+      TapeSize run_start = writer.GetWrittenSize();
+      if (!read_backward) {
+        MergeTapeRuns(readers, merge, run_writer);
+      } else if (descending) {
+        MergeTapeRunsBackward<Reversed<Less>>(readers, blocks, merge,
+                                              run_writer);
+      } else {
+        MergeTapeRunsBackward<Less>(readers, blocks, merge, run_writer);
+      }
+      // Equal elements of different runs are combined by the merge, but not
+      // with the ones of the next run on the tape.
+      run_writer.Flush();
+      if (std::any_of(merge.begin(), merge.end(),
+                      [](TapeSize size) { return size != 0; })) {
+        schedule.SetMergedRunSize(writer.GetWrittenSize() - run_start);
+      }
+    }
+    writer.Close();
+    output_size = writer.GetWrittenSize();
+
+    if (!last) {
+      // Both tapes are rewound: the output one to be read, the emptied one to
+      // be written. Read backward, the output tape is read from where it ends
+      // and the emptied one is written from where it starts.
+      ChunksNumber emptied = schedule.GetEmptiedTape();
+      if (!read_backward) {
+        tape_in_.context_.WaitForShift(schedule.GetTapeSize(output) +
+                                      schedule.GetTapeSize(emptied));
+      }
+      open_reader(output);
+      readers[emptied].reset();
+    }
+    schedule.EndPhase();
+    stats.phases_.push_back(phase_timer.Stop());
+  }
+  readers.clear();
+
+  tape_out_ = Tape<TapeType>{tape_out_.GetTapeFilePath(), output_size,
+                             std::min<ChunkSize>(block_size, output_size),
+                             tape_out_.GetFormat(), tape_in_.context_};
+}
+
+template <typename TapeType, typename Compare, typename KeyOfType>
+void TapeSorter<TapeType, Compare, KeyOfType>::MergeTapeRuns(
+    std::vector<std::optional<Tape<TapeType>>> &readers,
+    const std::vector<TapeSize> &run_sizes, RunWriter &writer) const {
+  std::vector<TapeSize> remaining = run_sizes;
+  LoserTree<TapeType, Less> tree(readers.size());
+  for (std::size_t i = 0; i < readers.size(); i++) {
+    if (remaining[i]) {
+      tree.Set(i, readers[i]->ReadCell());
+    }
+  }
+  tree.Build();
+
+  while (!tree.Empty()) {
+    writer.Write(tree.TopKey());
+    std::size_t top = tree.Top();
+    readers[top]->MoveLeft();
+    if (--remaining[top]) {
+      tree.Replace(readers[top]->ReadCell());
+    } else {
+      tree.Pop();
+    }
+  }
+}
+
+template <typename TapeType, typename Compare, typename KeyOfType>
+template <typename Order>
+void TapeSorter<TapeType, Compare, KeyOfType>::MergeTapeRunsBackward(
+    std::vector<std::optional<Tape<TapeType>>> &readers,
+    std::vector<std::span<const TapeType>> &blocks,
+    const std::vector<TapeSize> &run_sizes, RunWriter &writer) const {
+  auto read_previous = [&readers, &blocks](std::size_t tape) {
+    if (blocks[tape].empty()) {
+      readers[tape]->ReadChunkBackward();
+      blocks[tape] = readers[tape]->GetChunkElements();
+    }
+    TapeType element = blocks[tape].back();
+    blocks[tape] = blocks[tape].first(blocks[tape].size() - 1);
+    return element;
+  };
+
+  std::vector<TapeSize> remaining = run_sizes;
+  LoserTree<TapeType, Order> tree(readers.size());
+  for (std::size_t i = 0; i < readers.size(); i++) {
+    if (remaining[i]) {
+      tree.Set(i, read_previous(i));
+    }
+  }
+  tree.Build();
+
+  while (!tree.Empty()) {
+    writer.Write(tree.TopKey());
+    std::size_t top = tree.Top();
+    if (--remaining[top]) {
+      tree.Replace(read_previous(top));
+    } else {
+      tree.Pop();
+    }
+  }
+}
+
+template <typename TapeType, typename Compare, typename KeyOfType>
+Tape<TapeType> TapeSorter<TapeType, Compare, KeyOfType>::MergeRuns(
+    const std::filesystem::path &path, TapeFormat format,
+    std::span<Tape<TapeType>> runs, ChunkSize block_size) const {
+  if (runs.size() == 2 && !(options_.mapped_merge_ &&
+                            runs.front().GetFormat() == TapeFormat::kBinary)) {
+    return MergeTwoRuns(path, format, runs, block_size);
+  }
+
+  std::vector<std::unique_ptr<ITape<TapeType>>> readers;
+  readers.reserve(runs.size());
+  for (Tape<TapeType> &run : runs) {
+    readers.push_back(OpenRunReader(run, block_size));
+  }
+
+  TapeWriter<TapeType> tape_writer{path, block_size, tape_in_.context_, format};
+  RunWriter writer{tape_writer, options_.aggregation_};
+  LoserTree<TapeType, Less> tree(readers.size());
+  std::vector<TapeSize> remaining(readers.size());
+  for (std::size_t i = 0; i < readers.size(); i++) {
+    remaining[i] = runs[i].GetSize();
+    if (remaining[i]) {
+      tree.Set(i, readers[i]->ReadCell());
+    }
+  }
+  tree.Build();
+
+  while (tree.GetActiveNumber() > 1) {
+    writer.Write(tree.TopKey());
+    std::size_t top = tree.Top();
+    if (--remaining[top] && readers[top]->MoveLeft()) {
+      tree.Replace(readers[top]->ReadCell());
+    } else {
+      tree.Pop();
+      readers[top].reset();
+    }
+  }
+  if (!tree.Empty()) {
+    std::size_t last = tree.Top();
+    writer.Write(tree.TopKey());
+    if (--remaining[last] && readers[last]->MoveLeft()) {
+      CopyBlocks(*readers[last], remaining[last], writer, block_size);
     }
   }
+  writer.Flush();
+  tape_writer.Close();
+
+  TapeSize result_size = tape_writer.GetWrittenSize();
+  return Tape<TapeType>{path, result_size,
+                        std::min<ChunkSize>(block_size, result_size), format,
+                        tape_in_.context_};
+}
+
+template <typename TapeType, typename Compare, typename KeyOfType>
+Tape<TapeType> TapeSorter<TapeType, Compare, KeyOfType>::MergeTwoRuns(
+    const std::filesystem::path &path, TapeFormat format,
+    std::span<Tape<TapeType>> runs, ChunkSize block_size) const {
+  std::array<Tape<TapeType>, 2> readers{OpenRunTape(runs[0], block_size),
+                                        OpenRunTape(runs[1], block_size)};
+  std::array<TapeSize, 2> remaining{runs[0].GetSize(), runs[1].GetSize()};
+  std::array<std::span<const TapeType>, 2> blocks{};
+  auto next_block = [&readers, &remaining, &blocks](std::size_t run) {
+    if (!remaining[run]) {
+      blocks[run] = {};
+      return;
+    }
+    readers[run].ReadChunkToTheRight();
+    blocks[run] = readers[run].GetChunkElements();
+    remaining[run] -= blocks[run].size();
+  };
+  next_block(0);
+  next_block(1);
 
-  for (TapeType &element : buffer) {
-    tape_result.WriteToCell(element);
-    tape_result.MoveLeft();
+  // The output buffer is written at once, the writer does not buffer it.
+  TapeWriter<TapeType> tape_writer{path, 1, tape_in_.context_, format};
+  RunWriter writer{tape_writer, options_.aggregation_};
+  BudgetVector<TapeType> output(
+      block_size, BudgetAllocator<TapeType>(tape_in_.context_.budget_));
+  std::size_t filled = 0;
+  while (!blocks[0].empty() && !blocks[1].empty()) {
+    auto [first, second] = MergeBlocks<TapeType, Less>(
+        blocks[0], blocks[1], std::span<TapeType>(output).subspan(filled));
+    filled += first + second;
+    blocks[0] = blocks[0].subspan(first);
+    blocks[1] = blocks[1].subspan(second);
+    if (filled == output.size()) {
+      writer.WriteChunk(output);
+      filled = 0;
+    }
+    for (std::size_t run = 0; run < 2; run++) {
+      if (blocks[run].empty()) {
+        next_block(run);
+      }
+    }
+  }
+  writer.WriteChunk(std::span<const TapeType>(output).first(filled));
+  for (std::size_t run = 0; run < 2; run++) {
+    while (!blocks[run].empty()) {
+      writer.WriteChunk(blocks[run]);
+      next_block(run);
+    }
   }
+  writer.Flush();
+  tape_writer.Close();
 
-  return {end0, end1};
+  TapeSize result_size = tape_writer.GetWrittenSize();
+  return Tape<TapeType>{path, result_size,
+                        std::min<ChunkSize>(block_size, result_size), format,
+                        tape_in_.context_};
 }
 
-template <typename TapeType>
-void TapeSorter<TapeType>::PutTapeRestToBuffer(Tape<TapeType> &tape,
-                                               std::vector<TapeType> &buffer,
-                                               ChunkSize size) {
-  buffer.push_back(tape.ReadCell());
-  while (tape.MoveLeft() && buffer.size() != size) {
-    buffer.push_back(tape.ReadCell());
+template <typename TapeType, typename Compare, typename KeyOfType>
+void TapeSorter<TapeType, Compare, KeyOfType>::CopyBlocks(
+    ITape<TapeType> &from, TapeSize count, RunWriter &to,
+    ChunkSize block_size) const {
+  BudgetVector<TapeType> buffer(
+      std::min<TapeSize>(block_size, count),
+      BudgetAllocator<TapeType>(tape_in_.context_.budget_));
+  while (count) {
+    std::span<TapeType> block(buffer.data(),
+                              std::min<TapeSize>(buffer.size(), count));
+    TapeSize read = from.ReadBlock(block);
+    if (!read) {
+      break;
+    }
+    to.WriteChunk(block.first(read));
+    count -= read;
   }
 }
 
-template <typename TapeType>
-bool TapeSorter<TapeType>::PutElementInBuffer(Tape<TapeType> &tape,
-                                              std::vector<TapeType> &buffer,
-                                              bool &end) {
-  buffer.push_back(tape.ReadCell());
-  if (tape.MoveLeft()) {
-    return false;
+template <typename TapeType, typename Compare, typename KeyOfType>
+std::unique_ptr<ITape<TapeType>>
+TapeSorter<TapeType, Compare, KeyOfType>::OpenRunReader(
+    Tape<TapeType> &run, ChunkSize block_size) const {
+  if (options_.mapped_merge_ && run.GetFormat() == TapeFormat::kBinary) {
+    auto reader = std::make_unique<MappedTape<TapeType>>(
+        run.GetTapeFilePath(), run.GetMemorySize(), run.context_);
+    reader->SetWindowSize(block_size);
+    return reader;
   }
-  end = true;
-  return true;
+
+  return std::make_unique<Tape<TapeType>>(OpenRunTape(run, block_size));
+}
+
+template <typename TapeType, typename Compare, typename KeyOfType>
+Tape<TapeType> TapeSorter<TapeType, Compare, KeyOfType>::OpenRunTape(
+    Tape<TapeType> &run, ChunkSize block_size) const {
+  ChunkSize reader_block_size = options_.prefetch_
+                                    ? std::max<ChunkSize>(block_size / 2, 1)
+                                    : block_size;
+  Tape<TapeType> reader{run.GetTapeFilePath(), run.GetSize(),
+                        std::min<ChunkSize>(reader_block_size, run.GetSize()),
+                        run.GetFormat(), run.context_};
+  reader.SetPrefetch(options_.prefetch_);
+  return reader;
 }
 }  // namespace tape
@@ -0,0 +1,47 @@
+#include "operation_counters.hpp"
+
+namespace tape {
+std::string GetCounterName(TapeCounter counter) {
+  switch (counter) {
+    case TapeCounter::kCellsRead:
+      return "cells_read";
+    case TapeCounter::kCellsWritten:
+      return "cells_written";
+    case TapeCounter::kShifts:
+      return "shifts";
+    case TapeCounter::kChunkLoads:
+      return "chunk_loads";
+    case TapeCounter::kBytesRead:
+      return "bytes_read";
+    case TapeCounter::kBytesWritten:
+      return "bytes_written";
+    case TapeCounter::kTempFiles:
+      return "temp_files";
+  }
+  return "unknown";
+}
+
+void OperationCounters::Add(TapeCounter counter, uint64_t count) {
+  counts_[static_cast<std::size_t>(counter)].fetch_add(
+      count, std::memory_order_relaxed);
+}
+
+uint64_t OperationCounters::Get(TapeCounter counter) const {
+  return counts_[static_cast<std::size_t>(counter)].load(
+      std::memory_order_relaxed);
+}
+
+OperationCounts OperationCounters::GetCounts() const {
+  OperationCounts counts{};
+  for (std::size_t i = 0; i < kTapeCountersNumber; i++) {
+    counts[i] = counts_[i].load(std::memory_order_relaxed);
+  }
+  return counts;
+}
+
+void OperationCounters::Reset() {
+  for (std::atomic<uint64_t> &count : counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+}
+}  // namespace tape
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Counted operation of tapes.
+////////////////////////////////////////////////////////////////////////////////
+enum class TapeCounter : uint8_t {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Cells read by the magnetic head.
+  //////////////////////////////////////////////////////////////////////////////
+  kCellsRead,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Cells written by the magnetic head.
+  //////////////////////////////////////////////////////////////////////////////
+  kCellsWritten,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Moves of the tape by one position.
+  //////////////////////////////////////////////////////////////////////////////
+  kShifts,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Chunks read from files.
+  //////////////////////////////////////////////////////////////////////////////
+  kChunkLoads,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Bytes of the elements read from files.
+  //////////////////////////////////////////////////////////////////////////////
+  kBytesRead,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Bytes of the elements written to files.
+  //////////////////////////////////////////////////////////////////////////////
+  kBytesWritten,
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Temporary tapes created.
+  //////////////////////////////////////////////////////////////////////////////
+  kTempFiles
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Number of counted operations.
+////////////////////////////////////////////////////////////////////////////////
+inline constexpr std::size_t kTapeCountersNumber = 7;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Values of all counters, indexed by TapeCounter.
+////////////////////////////////////////////////////////////////////////////////
+using OperationCounts = std::array<uint64_t, kTapeCountersNumber>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Get the name of a counter used in reports, e.g. "cells_read".
+///
+/// \param counter counted operation.
+/// \return name of the counter.
+////////////////////////////////////////////////////////////////////////////////
+[[nodiscard]] std::string GetCounterName(TapeCounter counter);
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Counters of tape operations. They can be shared by tapes used from
+/// several threads. Tapes count only if the library is built with
+/// TAPE_SORTER_STATS.
+////////////////////////////////////////////////////////////////////////////////
+class OperationCounters {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief OperationCounters default constructor. The counters start at zero.
+  //////////////////////////////////////////////////////////////////////////////
+  OperationCounters() = default;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Add operations to a counter.
+  ///
+  /// \param counter counted operation.
+  /// \param count number of operations.
+  //////////////////////////////////////////////////////////////////////////////
+  void Add(TapeCounter counter, uint64_t count);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the value of a counter.
+  ///
+  /// \param counter counted operation.
+  /// \return number of operations.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] uint64_t Get(TapeCounter counter) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the values of all counters.
+  ///
+  /// \return numbers of operations.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] OperationCounts GetCounts() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Set all counters to zero.
+  //////////////////////////////////////////////////////////////////////////////
+  void Reset();
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of every kind of operations.
+  //////////////////////////////////////////////////////////////////////////////
+  std::atomic<uint64_t> counts_[kTapeCountersNumber]{};
+};
+}  // namespace tape
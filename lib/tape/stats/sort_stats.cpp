@@ -0,0 +1,50 @@
+#include "sort_stats.hpp"
+
+#include <sstream>
+
+namespace tape {
+uint64_t SortStats::GetCount(TapeCounter counter) const {
+  return counts_[static_cast<std::size_t>(counter)];
+}
+
+std::string SortStats::ToJson() const {
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+
+  std::ostringstream json;
+  json << "{\n";
+#ifdef TAPE_SORTER_STATS
+  json << "  \"counters\": {";
+  for (std::size_t i = 0; i < kTapeCountersNumber; i++) {
+    json << (i ? ", " : "") << '"'
+         << GetCounterName(static_cast<TapeCounter>(i))
+         << "\": " << counts_[i];
+  }
+  json << "},\n";
+#endif
+  json << "  \"phases\": [";
+  for (std::size_t i = 0; i < phases_.size(); i++) {
+    json << (i ? ",\n" : "\n") << "    {\"name\": \"" << phases_[i].name_
+         << "\", \"wall_ms\": "
+         << Milliseconds(phases_[i].wall_time_).count()
+         << ", \"cpu_ms\": " << Milliseconds(phases_[i].cpu_time_).count()
+         << '}';
+  }
+  json << "\n  ]\n}\n";
+  return json.str();
+}
+
+PhaseTimer::PhaseTimer(std::string name)
+    : name_(std::move(name)),
+      wall_start_(std::chrono::steady_clock::now()),
+      cpu_start_(std::clock()) {}
+
+PhaseTime PhaseTimer::Stop() const {
+  std::chrono::duration<double> cpu_time(
+      static_cast<double>(std::clock() - cpu_start_) / CLOCKS_PER_SEC);
+  return PhaseTime{
+      name_,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - wall_start_),
+      std::chrono::duration_cast<std::chrono::nanoseconds>(cpu_time)};
+}
+}  // namespace tape
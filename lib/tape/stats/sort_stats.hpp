@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "operation_counters.hpp"
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Time spent in a phase of a sort.
+////////////////////////////////////////////////////////////////////////////////
+struct PhaseTime {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Name of the phase.
+  //////////////////////////////////////////////////////////////////////////////
+  std::string name_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Wall-clock time of the phase.
+  //////////////////////////////////////////////////////////////////////////////
+  std::chrono::nanoseconds wall_time_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief CPU time of the process during the phase, all threads included.
+  //////////////////////////////////////////////////////////////////////////////
+  std::chrono::nanoseconds cpu_time_{};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Statistics of a sort.
+////////////////////////////////////////////////////////////////////////////////
+struct SortStats {
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of operations made by the sort.
+  ///
+  /// \param counter counted operation.
+  /// \return number of operations.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] uint64_t GetCount(TapeCounter counter) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Write the statistics as a JSON object. Counters are left out if
+  /// the library is built without TAPE_SORTER_STATS.
+  ///
+  /// \return JSON text.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::string ToJson() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Numbers of operations made by the sort.
+  //////////////////////////////////////////////////////////////////////////////
+  OperationCounts counts_{};
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Times of the split, of every merge pass and of the final merge.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<PhaseTime> phases_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Timer of a phase of a sort, started on construction.
+////////////////////////////////////////////////////////////////////////////////
+class PhaseTimer {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief PhaseTimer constructor.
+  ///
+  /// \param name name of the phase.
+  //////////////////////////////////////////////////////////////////////////////
+  explicit PhaseTimer(std::string name);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Measure the time since the timer was started.
+  ///
+  /// \return time of the phase.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] PhaseTime Stop() const;
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Name of the phase.
+  //////////////////////////////////////////////////////////////////////////////
+  std::string name_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Wall-clock time of the start.
+  //////////////////////////////////////////////////////////////////////////////
+  std::chrono::steady_clock::time_point wall_start_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief CPU time of the process at the start.
+  //////////////////////////////////////////////////////////////////////////////
+  std::clock_t cpu_start_{};
+};
+}  // namespace tape
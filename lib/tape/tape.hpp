@@ -1,10 +1,16 @@
 #pragma once
 
 #include <fstream>
+#include <future>
+#include <memory>
+#include <utility>
 
+#include "chunks_index/chunks_index.hpp"
 #include "chunks_info/chunks_info.hpp"
-#include "delays/delays.hpp"
+#include "delays/tape_context.hpp"
 #include "sorter/tape_sorter.hpp"
+#include "thread_pool/thread_pool.hpp"
+#include "writer/tape_writer.hpp"
 
 namespace tape {
 
@@ -27,24 +33,61 @@ class Tape : public ITape<TapeType> {
   Tape() = default;
 
   Tape(const std::filesystem::path &file, TapeSize size, MemorySize memory_size,
-       const Delays &delays);
+       const TapeContext &context, TapeFormat format = TapeFormat::kText);
   Tape(const std::filesystem::path &file, TapeSize size, MemorySize memory_size,
        const std::chrono::milliseconds &delay_for_reading,
        const std::chrono::milliseconds &delay_for_write,
-       const std::chrono::milliseconds &delay_for_shift);
+       const std::chrono::milliseconds &delay_for_shift,
+       TapeFormat format = TapeFormat::kText);
   Tape(const std::filesystem::path &file,
        const std::chrono::milliseconds &delay_for_reading,
        const std::chrono::milliseconds &delay_for_writing,
-       const std::chrono::milliseconds &delay_for_shift);
-  Tape(const Delays &delays);
+       const std::chrono::milliseconds &delay_for_shift,
+       TapeFormat format = TapeFormat::kText);
+  Tape(const std::filesystem::path &file, const TapeContext &context,
+       TapeFormat format = TapeFormat::kText);
+  Tape(const TapeContext &context);
 
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Tape copy constructor. The copy is another handle of the same
+  /// file, the file is not copied. Use Clone to copy it.
+  //////////////////////////////////////////////////////////////////////////////
   Tape(const Tape &);
-  Tape(const Tape &, std::filesystem::path &path);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Tape copy assignment. The tape becomes another handle of the file
+  /// of the other tape, the file is not copied. Use Clone to copy it.
+  //////////////////////////////////////////////////////////////////////////////
   Tape &operator=(const Tape &);
 
   Tape(Tape &&) noexcept;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Tape move assignment. The tape takes over the file and the file
+  /// stream of the other tape without touching the data. The file of the tape
+  /// is left as it is, use MoveTo to put the file in its place.
+  //////////////////////////////////////////////////////////////////////////////
   Tape &operator=(Tape &&) noexcept;
 
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Copy the file of the tape.
+  ///
+  /// \param path path to the copy of the file.
+  /// \return tape of the copy.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] Tape Clone(const std::filesystem::path &path) const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Move the file of the tape to another path, replacing the file
+  /// there. A renamed file keeps the open stream of the tape valid; a file on
+  /// another file system is copied, and removed only once the copy succeeded.
+  /// Throws std::filesystem::filesystem_error if the file can not be moved,
+  /// the tape then keeps its file.
+  ///
+  /// \param path new path to the file.
+  //////////////////////////////////////////////////////////////////////////////
+  void MoveTo(const std::filesystem::path &path);
+
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Tape desctructor.
   //////////////////////////////////////////////////////////////////////////////
@@ -82,6 +125,37 @@ class Tape : public ITape<TapeType> {
   //////////////////////////////////////////////////////////////////////////////
   bool MoveLeft() override;
 
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Read consecutive elements starting from the cell indicated by the
+  /// magnetic head and move the tape to the left by their number. The
+  /// elements are copied chunk by chunk and the delays are charged at once.
+  /// At the end of the tape nothing is read.
+  ///
+  /// \param elements buffer for the read elements.
+  /// \return number of read elements.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeSize ReadBlock(std::span<TapeType> elements) override;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Put consecutive elements starting from the cell indicated by the
+  /// magnetic head and move the tape to the left by their number. A binary
+  /// tape is written with one seek and the delays are charged at once. At the
+  /// end of the tape nothing is put.
+  ///
+  /// \param elements new elements.
+  /// \return number of put elements.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeSize WriteBlock(std::span<const TapeType> elements) override;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Move the tape so that the magnetic head points to the given cell.
+  /// Only the chunk containing the cell is read.
+  ///
+  /// \param cell number of the cell.
+  /// \return true if the move succeeded else false.
+  //////////////////////////////////////////////////////////////////////////////
+  bool MoveToCell(TapeSize cell);
+
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Get the path to the file where the tape is located.
   ///
@@ -89,6 +163,13 @@ class Tape : public ITape<TapeType> {
   //////////////////////////////////////////////////////////////////////////////
   [[nodiscard]] std::filesystem::path GetTapeFilePath() const;
 
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the format of the file where the tape is located.
+  ///
+  /// \return tape format.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] TapeFormat GetFormat() const;
+
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Get the size of tape.
   ///
@@ -130,19 +211,39 @@ class Tape : public ITape<TapeType> {
   ///
   /// \return elements of chunks.
   //////////////////////////////////////////////////////////////////////////////
-  [[nodiscard]] std::vector<TapeType> GetChunkElements() const;
+  [[nodiscard]] std::span<const TapeType> GetChunkElements() const;
 
   //////////////////////////////////////////////////////////////////////////////
-  /// \brief Clear current chunk.
+  /// \brief Clear current chunk and free its memory.
   //////////////////////////////////////////////////////////////////////////////
   void ClearChunkInTape();
 
-  template <typename T>
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Turn on or off prefetching: while the current chunk is processed,
+  /// the chunk to the right of it is read in the background by a reader
+  /// thread of the tape, so moving past the right edge only swaps the
+  /// buffers. Prefetching keeps a second chunk in memory.
+  ///
+  /// \param prefetch true to turn prefetching on.
+  //////////////////////////////////////////////////////////////////////////////
+  void SetPrefetch(bool prefetch);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Divide the tape into chunks of another size. The magnetic head
+  /// returns to the first cell.
+  ///
+  /// \param max_chunk_size size of a chunk.
+  //////////////////////////////////////////////////////////////////////////////
+  void SetMaxChunkSize(ChunkSize max_chunk_size);
+
+  template <typename T, typename Compare, typename KeyOfType>
   friend class TapeSorter;
+  template <typename T>
+  friend class RunStore;
 
  private:
   Tape(const std::filesystem::path &file, TapeSize size,
-       ChunkSize max_chunk_size);
+       ChunkSize max_chunk_size, TapeFormat format, const TapeContext &context);
 
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Initializing the first chunk.
@@ -152,6 +253,12 @@ class Tape : public ITape<TapeType> {
   //////////////////////////////////////////////////////////////////////////////
   bool InitFirstChunk();
 
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Open the stream of the file for reading and check the header of
+  /// a binary tape.
+  //////////////////////////////////////////////////////////////////////////////
+  void OpenForReading();
+
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Read the chunk to the right of the current one.
   //////////////////////////////////////////////////////////////////////////////
@@ -163,12 +270,127 @@ class Tape : public ITape<TapeType> {
   void ReadChunkToTheLeft();
 
   //////////////////////////////////////////////////////////////////////////////
-  /// \brief Rewrite tape from one file to another.
+  /// \brief Read the tape backward by chunks: the last chunk of an unused
+  /// tape, else the chunk to the left of the current one. The magnetic head
+  /// stays on the left edge of the chunk, where the next one starts, so the
+  /// elements are taken by GetChunkElements without moving back.
+  //////////////////////////////////////////////////////////////////////////////
+  void ReadChunkBackward();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Take the elements of the current chunk out of the tape without
+  /// copying them. The chunk must be read again before its cells are used.
+  ///
+  /// \return vector of elements.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] BudgetVector<TapeType> TakeChunkElements();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Give back the elements taken by TakeChunkElements, so that the
+  /// next chunk is read into their buffer.
+  ///
+  /// \param elements buffer of elements.
+  //////////////////////////////////////////////////////////////////////////////
+  void ReturnChunkElements(BudgetVector<TapeType> &&elements);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of the cell indicated by the magnetic head.
+  ///
+  /// \return number of the cell.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] TapeSize GetCurrentCell() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Put the magnetic head on the given cell at once, reading its chunk
+  /// if needed. The caller is charged for the movement.
+  ///
+  /// \param cell number of the cell.
+  //////////////////////////////////////////////////////////////////////////////
+  void JumpToCell(TapeSize cell);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Read the chunk with the given number.
+  ///
+  /// \param chunk_number number of the chunk.
+  //////////////////////////////////////////////////////////////////////////////
+  void ReadChunk(ChunksNumber chunk_number);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Set the position of the file stream to the first element of the
+  /// chunk. For text tapes the chunks index is used and extended if needed.
+  ///
+  /// \param chunk_number number of the chunk.
+  //////////////////////////////////////////////////////////////////////////////
+  void SeekToChunk(ChunksNumber chunk_number);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Record the offset of the chunk following the one that has just
+  /// been read.
+  ///
+  /// \param chunk_number number of the chunk that has just been read.
+  //////////////////////////////////////////////////////////////////////////////
+  void RecordNextChunkOffset(ChunksNumber chunk_number);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Record the offset of a chunk of a text tape if the chunk is
+  /// present in the file.
+  ///
+  /// \param chunk_number number of the chunk.
+  /// \param offset offset of the first element of the chunk.
+  //////////////////////////////////////////////////////////////////////////////
+  void RecordChunkOffset(ChunksNumber chunk_number, std::streampos offset);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Start reading the chunk in the background if prefetching is on
+  /// and the position of the chunk in the file is known.
+  ///
+  /// \param chunk_number number of the chunk.
+  //////////////////////////////////////////////////////////////////////////////
+  void StartPrefetch(ChunksNumber chunk_number);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Make the prefetched chunk current. A prefetched chunk with
+  /// another number is dropped.
+  ///
+  /// \param chunk_number number of the required chunk.
+  /// \return true if the chunk was prefetched else false.
+  //////////////////////////////////////////////////////////////////////////////
+  bool TakePrefetchedChunk(ChunksNumber chunk_number);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Wait for the background reading and drop its result.
+  //////////////////////////////////////////////////////////////////////////////
+  void DropPrefetch();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Put a new element right after the last element present in the
+  /// file. Only the new element is written, the rest of the file is untouched.
+  ///
+  /// \param element element to put.
+  //////////////////////////////////////////////////////////////////////////////
+  void AppendToCell(const TapeType &element);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Count the elements present in the file. A missing or empty file
+  /// has none, otherwise the file is expected to hold the whole tape.
+  ///
+  /// \return number of elements present in the file.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] TapeSize CountFilledCells() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Put a new element to the cell of a binary tape. Fixed-width cells
+  /// are overwritten in place.
   ///
-  /// \param from file stream from where the tape is being read.
-  /// \param to file stream where the tape is recorded.
+  /// \param cell number of the cell.
+  /// \param element element to put.
+  //////////////////////////////////////////////////////////////////////////////
+  void WriteBinaryCell(TapeSize cell, const TapeType &element);
+
   //////////////////////////////////////////////////////////////////////////////
-  static void RewriteFromTo(std::fstream &from, std::fstream &to);
+  /// \brief Open the file stream of the tape for reading and writing.
+  //////////////////////////////////////////////////////////////////////////////
+  void OpenStream();
 
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Put a new element in the current chunk.
@@ -217,21 +439,37 @@ class Tape : public ITape<TapeType> {
   //////////////////////////////////////////////////////////////////////////////
   TapeSize size_{};
 
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Format of the file where the tape is located.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeFormat format_ = TapeFormat::kText;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of elements actually present in the file. The cells after
+  /// them are not written yet.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeSize filled_{};
+
   //////////////////////////////////////////////////////////////////////////////
   /// \brief
   //////////////////////////////////////////////////////////////////////////////
   MemorySize memory_size_{};
 
   //////////////////////////////////////////////////////////////////////////////
-  /// \brief Delays in reading, putting and shifting.
+  /// \brief Delays in reading, putting and shifting, and the memory budget.
   //////////////////////////////////////////////////////////////////////////////
-  Delays delays_{};
+  TapeContext context_{};
 
   //////////////////////////////////////////////////////////////////////////////
   /// \brief Information about chunks.
   //////////////////////////////////////////////////////////////////////////////
   ChunksInfo chunks_info_;
 
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Offsets of chunks in the file of a text tape.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunksIndex chunks_index_{};
+
   //////////////////////////////////////////////////////////////////////////////
   /// \brief The current chunk.
   //////////////////////////////////////////////////////////////////////////////
@@ -244,9 +482,42 @@ class Tape : public ITape<TapeType> {
   bool unused_ = true;
 
   //////////////////////////////////////////////////////////////////////////////
-  /// \brief
+  /// \brief Prefetching flag.
   //////////////////////////////////////////////////////////////////////////////
-  static const MemorySize kDivider = 16;
+  bool prefetch_ = false;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief File stream used by the background reading only.
+  //////////////////////////////////////////////////////////////////////////////
+  std::shared_ptr<std::fstream> prefetch_stream_;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Reader thread of the background reading, started with the first
+  /// prefetched chunk and kept until prefetching stops.
+  //////////////////////////////////////////////////////////////////////////////
+  std::unique_ptr<ThreadPool> prefetch_reader_;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of the chunk being prefetched.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunksNumber next_chunk_number_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Prefetched chunk and the offset of the chunk following it.
+  //////////////////////////////////////////////////////////////////////////////
+  std::future<std::pair<Chunk<TapeType>, std::streampos>> next_chunk_;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Buffer of the chunk replaced by the prefetched one. The next chunk
+  /// is prefetched into it.
+  //////////////////////////////////////////////////////////////////////////////
+  BudgetVector<TapeType> spare_elements_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of chunks the memory is divided into: the chunk of the tape
+  /// and buffers of the code working with it.
+  //////////////////////////////////////////////////////////////////////////////
+  static constexpr MemorySize kBuffersNumber = 4;
 
   //////////////////////////////////////////////////////////////////////////////
   /// \brief
@@ -256,14 +527,18 @@ class Tape : public ITape<TapeType> {
 
 template <typename TapeType>
 Tape<TapeType>::Tape(const std::filesystem::path &file, TapeSize size,
-                     MemorySize memory_size, const Delays &delays)
+                     MemorySize memory_size, const TapeContext &context,
+                     TapeFormat format)
     : tape_location_(file),
       size_(size),
+      format_(format),
       memory_size_(memory_size),
-      delays_(delays) {
+      context_(context) {
+  filled_ = CountFilledCells();
   chunks_info_ = ChunksInfo(CalculateChunkSize(memory_size_, size_), size_);
-  current_chunk_ = Chunk<TapeType>(delays_, 0, chunks_info_.max_chunk_size_);
-  stream_from_.open(tape_location_);
+  current_chunk_ =
+      Chunk<TapeType>(context_, 0, chunks_info_.max_chunk_size_, format_);
+  OpenStream();
 }
 
 template <typename TapeType>
@@ -271,76 +546,80 @@ Tape<TapeType>::Tape(const std::filesystem::path &file, TapeSize size,
                      MemorySize memory_size,
                      const std::chrono::milliseconds &delay_for_reading,
                      const std::chrono::milliseconds &delay_for_writing,
-                     const std::chrono::milliseconds &delay_for_shift)
+                     const std::chrono::milliseconds &delay_for_shift,
+                     TapeFormat format)
     : Tape(file, size, memory_size,
-           Delays(delay_for_reading, delay_for_writing, delay_for_shift)) {}
+           Delays(delay_for_reading, delay_for_writing, delay_for_shift),
+           format) {}
 
 template <typename TapeType>
 Tape<TapeType>::Tape(const std::filesystem::path &file,
                      const std::chrono::milliseconds &delay_for_reading,
                      const std::chrono::milliseconds &delay_for_writing,
-                     const std::chrono::milliseconds &delay_for_shift)
-    : tape_location_(file),
-      delays_(delay_for_reading, delay_for_writing, delay_for_shift) {
-  stream_from_.open(tape_location_);
+                     const std::chrono::milliseconds &delay_for_shift,
+                     TapeFormat format)
+    : Tape(file, Delays(delay_for_reading, delay_for_writing, delay_for_shift),
+           format) {}
+
+template <typename TapeType>
+Tape<TapeType>::Tape(const std::filesystem::path &file,
+                     const TapeContext &context, TapeFormat format)
+    : tape_location_(file), format_(format), context_(context) {
+  OpenStream();
 }
 
 template <typename TapeType>
 Tape<TapeType>::Tape(const std::filesystem::path &file, TapeSize size,
-                     ChunkSize max_chunk_size)
-    : Tape(file, std::chrono::milliseconds::zero(),
-           std::chrono::milliseconds::zero(),
-           std::chrono::milliseconds::zero()) {
+                     ChunkSize max_chunk_size, TapeFormat format,
+                     const TapeContext &context)
+    : Tape(file, context, format) {
   size_ = size;
+  filled_ = CountFilledCells();
   memory_size_ = size_;
   chunks_info_ = ChunksInfo(max_chunk_size, size_);
-  current_chunk_ = Chunk<TapeType>(delays_, 0, chunks_info_.max_chunk_size_);
+  current_chunk_ =
+      Chunk<TapeType>(context_, 0, chunks_info_.max_chunk_size_, format_);
 }
 
 template <typename TapeType>
-Tape<TapeType>::Tape(const Delays &delays) : delays_(delays) {}
+Tape<TapeType>::Tape(const TapeContext &context) : context_(context) {}
 
 template <typename TapeType>
 Tape<TapeType>::Tape(const Tape &other)
     : tape_location_(other.tape_location_),
-      delays_(other.delays_),
+      context_(other.context_),
       size_(other.size_),
+      format_(other.format_),
+      filled_(other.filled_),
       memory_size_(other.memory_size_),
       chunks_info_(other.chunks_info_),
-      current_chunk_(other.current_chunk_) {}
-
-template <typename TapeType>
-Tape<TapeType>::Tape(const Tape &other, std::filesystem::path &path)
-    : Tape(other) {
-  tape_location_ = path;
-  stream_from_.open(tape_location_);
-  std::fstream other_file(other.tape_location_);
-  RewriteFromTo(other_file, stream_from_);
-  stream_from_.close();
-  other_file.close();
-}
+      chunks_index_(other.chunks_index_),
+      current_chunk_(other.current_chunk_),
+      prefetch_(other.prefetch_) {}
 
 template <typename TapeType>
 Tape<TapeType> &Tape<TapeType>::operator=(const Tape &other) {
+  if (&other == this) {
+    return *this;
+  }
+
+  DropPrefetch();
+  prefetch_stream_.reset();
+  prefetch_reader_.reset();
+  stream_from_.close();
+  prefetch_ = other.prefetch_;
   tape_location_ = other.tape_location_;
-  delays_ = other.delays_;
+  context_ = other.context_;
   size_ = other.size_;
+  format_ = other.format_;
+  filled_ = other.filled_;
   memory_size_ = other.memory_size_;
   chunks_info_ = other.chunks_info_;
+  chunks_index_ = other.chunks_index_;
   current_chunk_ = other.current_chunk_;
-  unused_ = other.unused_;
-
-  if (exists(tape_location_)) {
-    if (stream_from_.is_open()) {
-      stream_from_.close();
-    }
-    stream_from_.open(tape_location_, std::ios::in | std::ios::out);
-    std::fstream other_file(other.tape_location_);
-    RewriteFromTo(other_file, stream_from_);
-    stream_from_.close();
-  } else {
-    tape_location_ = other.tape_location_;
-  }
+  // The file is opened again by the first access, as by the copy constructor.
+  unused_ = true;
+  this->at_end_ = false;
 
   return *this;
 }
@@ -356,31 +635,69 @@ Tape<TapeType> &Tape<TapeType>::operator=(Tape &&other) noexcept {
     return *this;
   }
 
-  std::swap(other.delays_, delays_);
+  DropPrefetch();
+  other.DropPrefetch();
+  prefetch_stream_.reset();
+  prefetch_reader_.reset();
+  other.prefetch_stream_.reset();
+  other.prefetch_reader_.reset();
+  stream_from_.close();
+
+  tape_location_ = std::move(other.tape_location_);
+  other.tape_location_.clear();
+
+  std::swap(other.stream_from_, stream_from_);
+  std::swap(other.prefetch_, prefetch_);
+  std::swap(other.context_, context_);
   std::swap(other.size_, size_);
+  std::swap(other.format_, format_);
+  std::swap(other.filled_, filled_);
   std::swap(other.memory_size_, memory_size_);
   std::swap(other.chunks_info_, chunks_info_);
+  std::swap(other.chunks_index_, chunks_index_);
   std::swap(other.current_chunk_, current_chunk_);
   std::swap(other.unused_, unused_);
+  std::swap(other.at_end_, this->at_end_);
+
+  return *this;
+}
 
-  if (exists(tape_location_)) {
-    if (stream_from_.is_open()) stream_from_.close();
-    stream_from_.open(tape_location_, std::ios::in | std::ios::out);
-    other.stream_from_.close();
-    other.stream_from_.open(other.tape_location_, std::ios::in | std::ios::out);
-    RewriteFromTo(other.stream_from_, stream_from_);
+template <typename TapeType>
+Tape<TapeType> Tape<TapeType>::Clone(const std::filesystem::path &path) const {
+  std::filesystem::copy_file(tape_location_, path,
+                             std::filesystem::copy_options::overwrite_existing);
+  Tape<TapeType> clone(*this);
+  clone.tape_location_ = path;
+  return clone;
+}
+
+template <typename TapeType>
+void Tape<TapeType>::MoveTo(const std::filesystem::path &path) {
+  if (path == tape_location_) {
+    return;
+  }
+  DropPrefetch();
+  prefetch_stream_.reset();
+  prefetch_reader_.reset();
+
+  std::error_code error;
+  std::filesystem::rename(tape_location_, path, error);
+  if (error) {
+    // A file on another file system is copied, the copy is opened again by
+    // the first access.
+    std::filesystem::copy_file(
+        tape_location_, path,
+        std::filesystem::copy_options::overwrite_existing);
     stream_from_.close();
-  } else {
-    tape_location_ = other.tape_location_;
+    unused_ = true;
+    std::filesystem::remove(tape_location_);
   }
-  other.tape_location_ = "";
-  other.stream_from_.close();
-
-  return *this;
+  tape_location_ = path;
 }
 
 template <typename TapeType>
 Tape<TapeType>::~Tape() {
+  DropPrefetch();
   stream_from_.close();
 }
 
@@ -395,8 +712,19 @@ TapeType Tape<TapeType>::ReadCell() {
 
 template <typename TapeType>
 void Tape<TapeType>::WriteToCell(const TapeType &element) {
+  DropPrefetch();
   ChunkSize current_pos = current_chunk_.GetPos();
   ChunksNumber current_chunk_number = current_chunk_.GetChunkNumber();
+  TapeSize cell = current_chunk_number * chunks_info_.max_chunk_size_ +
+                  current_pos;
+  if (format_ == TapeFormat::kBinary && cell < size_) {
+    WriteBinaryCell(cell, element);
+    return;
+  }
+  if (cell == filled_ && cell < size_) {
+    AppendToCell(element);
+    return;
+  }
   if (InitFirstChunk()) {
     current_chunk_.MoveRightPos();
   }
@@ -445,7 +773,7 @@ void Tape<TapeType>::WriteToCell(const TapeType &element) {
   }
 
   stream_from_.close();
-  stream_from_.open(tape_location_, std::ios::in | std::ios::out);
+  OpenStream();
   tmp_to.close();
   tmp_to.open(tmp_path, std::ios::in);
   stream_from_.seekg(0);
@@ -461,12 +789,66 @@ void Tape<TapeType>::WriteToCell(const TapeType &element) {
 
   tmp_to.close();
   std::filesystem::remove_all(kDirForTempTapes_);
+  filled_ = size_;
+  chunks_index_.Truncate(0);
 
   while (!current_chunk_.IsMatchWith(current_pos, current_chunk_number)) {
     MoveRight();
   }
 }
 
+template <typename TapeType>
+void Tape<TapeType>::AppendToCell(const TapeType &element) {
+  if (!stream_from_.is_open()) {
+    std::fstream create(tape_location_, std::fstream::out | std::fstream::app);
+    create.close();
+    OpenStream();
+  }
+  if (InitFirstChunk()) {
+    current_chunk_.MoveToLeftEdge();
+  }
+  ChunkSize current_pos = current_chunk_.GetPos();
+
+  stream_from_.clear();
+  stream_from_.seekp(0, std::ios::end);
+  context_.WaitForWriting();
+  context_.Count(TapeCounter::kBytesWritten, sizeof(TapeType));
+  stream_from_ << element << ' ';
+  stream_from_.flush();
+  filled_++;
+  chunks_index_.Truncate(current_chunk_.GetChunkNumber() + 1);
+
+  current_chunk_.PutElementInArrayByPos(element, current_pos);
+}
+
+template <typename TapeType>
+void Tape<TapeType>::WriteBinaryCell(TapeSize cell, const TapeType &element) {
+  if (!stream_from_.is_open()) {
+    std::fstream create(tape_location_,
+                        OpenMode(format_, std::fstream::out));
+    BinaryTapeHeader::For<TapeType>(0).Write(create);
+    create.close();
+    OpenStream();
+  }
+  if (InitFirstChunk()) {
+    current_chunk_.MoveToLeftEdge();
+  }
+  ChunkSize current_pos = current_chunk_.GetPos();
+
+  stream_from_.clear();
+  stream_from_.seekp(BinaryCellOffset<TapeType>(cell));
+  context_.WaitForWriting();
+  context_.Count(TapeCounter::kBytesWritten, sizeof(TapeType));
+  WriteElements(stream_from_, std::span<const TapeType>(&element, 1), format_);
+  if (cell >= filled_) {
+    filled_ = cell + 1;
+    BinaryTapeHeader::UpdateElementsNumber(stream_from_, filled_);
+  }
+  stream_from_.flush();
+
+  current_chunk_.PutElementInArrayByPos(element, current_pos);
+}
+
 template <typename TapeType>
 bool Tape<TapeType>::MoveRight() {
   if (InitFirstChunk()) {
@@ -477,6 +859,7 @@ bool Tape<TapeType>::MoveRight() {
     if (!current_chunk_.MoveRightPos()) {
       ReadChunkToTheLeft();
     }
+    this->at_end_ = false;
     return true;
   }
   return false;
@@ -497,11 +880,106 @@ bool Tape<TapeType>::MoveLeft() {
   return false;
 }
 
+template <typename TapeType>
+TapeSize Tape<TapeType>::ReadBlock(std::span<TapeType> elements) {
+  if (elements.empty() || !size_ || this->at_end_) {
+    return 0;
+  }
+  if (InitFirstChunk()) {
+    current_chunk_.MoveToLeftEdge();
+  }
+  TapeSize cell = GetCurrentCell();
+  TapeSize count = std::min<std::size_t>(elements.size(), size_ - cell);
+
+  TapeSize read = current_chunk_.CopyElementsFromPos(elements.first(count));
+  while (read < count) {
+    ChunksNumber chunk_number = current_chunk_.GetChunkNumber() + 1;
+    ReadChunk(chunk_number);
+    StartPrefetch(chunk_number + 1);
+    current_chunk_.JumpToPos(0);
+    read += current_chunk_.CopyElementsFromPos(
+        elements.subspan(read, count - read));
+  }
+  TapeSize target = std::min<TapeSize>(cell + count, size_ - 1);
+  JumpToCell(target);
+  this->at_end_ = cell + count == size_;
+
+  context_.WaitForReading(count);
+  context_.WaitForShift(target - cell);
+  return count;
+}
+
+template <typename TapeType>
+TapeSize Tape<TapeType>::WriteBlock(std::span<const TapeType> elements) {
+  if (elements.empty() || !size_ || this->at_end_) {
+    return 0;
+  }
+  if (format_ != TapeFormat::kBinary) {
+    return ITape<TapeType>::WriteBlock(elements);
+  }
+  DropPrefetch();
+  if (!stream_from_.is_open()) {
+    std::fstream create(tape_location_,
+                        OpenMode(format_, std::fstream::out));
+    BinaryTapeHeader::For<TapeType>(0).Write(create);
+    create.close();
+    OpenStream();
+  }
+  if (InitFirstChunk()) {
+    current_chunk_.MoveToLeftEdge();
+  }
+  TapeSize cell = GetCurrentCell();
+  TapeSize count = std::min<std::size_t>(elements.size(), size_ - cell);
+
+  stream_from_.clear();
+  stream_from_.seekp(BinaryCellOffset<TapeType>(cell));
+  context_.Count(TapeCounter::kBytesWritten, count * sizeof(TapeType));
+  WriteElements(stream_from_, elements.first(count), format_);
+  if (cell + count > filled_) {
+    filled_ = cell + count;
+    BinaryTapeHeader::UpdateElementsNumber(stream_from_, filled_);
+  }
+  stream_from_.flush();
+
+  current_chunk_.PutElementsFromPos(elements.first(count));
+  TapeSize target = std::min<TapeSize>(cell + count, size_ - 1);
+  JumpToCell(target);
+  this->at_end_ = cell + count == size_;
+
+  context_.WaitForWriting(count);
+  context_.WaitForShift(target - cell);
+  return count;
+}
+
+template <typename TapeType>
+bool Tape<TapeType>::MoveToCell(TapeSize cell) {
+  if (cell >= size_) {
+    return false;
+  }
+  if (InitFirstChunk()) {
+    current_chunk_.MoveToLeftEdge();
+  }
+
+  ChunksNumber chunk_number = cell / chunks_info_.max_chunk_size_;
+  if (chunk_number != current_chunk_.GetChunkNumber()) {
+    ReadChunk(chunk_number);
+  }
+  current_chunk_.MoveToPos(cell % chunks_info_.max_chunk_size_);
+  this->at_end_ = false;
+
+  return true;
+}
+
 template <typename TapeType>
 std::filesystem::path Tape<TapeType>::GetTapeFilePath() const {
   return tape_location_;
 }
 
+template <typename TapeType>
+TapeFormat Tape<TapeType>::GetFormat() const {
+  return format_;
+}
+
 template <typename TapeType>
 TapeSize Tape<TapeType>::GetSize() const {
   return size_;
@@ -528,7 +1006,7 @@ ChunkSize Tape<TapeType>::GetMinChunkSize() const {
 }
 
 template <typename TapeType>
-std::vector<TapeType> Tape<TapeType>::GetChunkElements() const {
+std::span<const TapeType> Tape<TapeType>::GetChunkElements() const {
   return current_chunk_.GetChunkElements();
 }
 
@@ -537,57 +1015,262 @@ void Tape<TapeType>::ClearChunkInTape() {
   current_chunk_.Destroy();
 }
 
+template <typename TapeType>
+void Tape<TapeType>::SetPrefetch(bool prefetch) {
+  if (!prefetch) {
+    DropPrefetch();
+    prefetch_stream_.reset();
+    prefetch_reader_.reset();
+    spare_elements_.clear();
+    spare_elements_.shrink_to_fit();
+  }
+  prefetch_ = prefetch;
+}
+
+template <typename TapeType>
+void Tape<TapeType>::SetMaxChunkSize(ChunkSize max_chunk_size) {
+  DropPrefetch();
+  chunks_info_ = ChunksInfo(std::min<TapeSize>(max_chunk_size, size_), size_);
+  chunks_index_ = ChunksIndex{};
+  current_chunk_ =
+      Chunk<TapeType>(context_, 0, chunks_info_.max_chunk_size_, format_);
+  unused_ = true;
+  this->at_end_ = false;
+}
+
 template <typename TapeType>
 bool Tape<TapeType>::InitFirstChunk() {
   if (!unused_) {
     return false;
   }
-  stream_from_.open(tape_location_);
+  OpenForReading();
+  SeekToChunk(0);
   current_chunk_.ReadNewChunk(stream_from_, 0, chunks_info_.max_chunk_size_);
+  RecordNextChunkOffset(0);
   unused_ = false;
+  StartPrefetch(1);
 
   return true;
 }
 
+template <typename TapeType>
+void Tape<TapeType>::OpenForReading() {
+  if (stream_from_.is_open()) {
+    stream_from_.clear();
+  } else {
+    OpenStream();
+  }
+  if (format_ == TapeFormat::kBinary && filled_ != 0) {
+    stream_from_.seekg(0);
+    BinaryTapeHeader::Read(stream_from_).CheckFor<TapeType>();
+  }
+}
+
+template <typename TapeType>
+void Tape<TapeType>::ReadChunkBackward() {
+  ChunksNumber chunk_number = current_chunk_.GetChunkNumber() - 1;
+  if (unused_) {
+    OpenForReading();
+    unused_ = false;
+    chunk_number = chunks_info_.chunks_number_ - 1;
+  }
+  ReadChunk(chunk_number);
+  current_chunk_.JumpToPos(0);
+}
+
 template <typename TapeType>
 void Tape<TapeType>::ReadChunkToTheRight() {
   if (InitFirstChunk()) {
     return;
   }
 
-  ChunksNumber current_chunk_number = current_chunk_.GetChunkNumber();
-  current_chunk_.ReadNewChunk(
-      stream_from_, current_chunk_number + 1,
-      current_chunk_number + 1 == chunks_info_.chunks_number_ - 1
-          ? chunks_info_.last_chunk_size_
-          : chunks_info_.max_chunk_size_);
+  ChunksNumber chunk_number = current_chunk_.GetChunkNumber() + 1;
+  ReadChunk(chunk_number);
   current_chunk_.MoveToLeftEdge();
+  StartPrefetch(chunk_number + 1);
+}
+
+template <typename TapeType>
+BudgetVector<TapeType> Tape<TapeType>::TakeChunkElements() {
+  return current_chunk_.TakeElements();
+}
+
+template <typename TapeType>
+void Tape<TapeType>::ReturnChunkElements(BudgetVector<TapeType> &&elements) {
+  current_chunk_.ReturnElements(std::move(elements));
 }
 
 template <typename TapeType>
 void Tape<TapeType>::ReadChunkToTheLeft() {
-  stream_from_.seekp(0);
-  stream_from_.seekg(0);
+  ReadChunk(current_chunk_.GetChunkNumber() - 1);
+  current_chunk_.MoveToRightEdge();
+}
 
-  ChunksNumber current_chunk_number = current_chunk_.GetChunkNumber();
+template <typename TapeType>
+TapeSize Tape<TapeType>::GetCurrentCell() const {
+  return current_chunk_.GetChunkNumber() * chunks_info_.max_chunk_size_ +
+         current_chunk_.GetPos();
+}
+
+template <typename TapeType>
+void Tape<TapeType>::JumpToCell(TapeSize cell) {
+  ChunksNumber chunk_number = cell / chunks_info_.max_chunk_size_;
+  if (chunk_number != current_chunk_.GetChunkNumber()) {
+    ReadChunk(chunk_number);
+    StartPrefetch(chunk_number + 1);
+  }
+  current_chunk_.JumpToPos(cell % chunks_info_.max_chunk_size_);
+}
+
+template <typename TapeType>
+void Tape<TapeType>::ReadChunk(ChunksNumber chunk_number) {
+  if (TakePrefetchedChunk(chunk_number)) {
+    return;
+  }
+  SeekToChunk(chunk_number);
+  current_chunk_.ReadNewChunk(stream_from_, chunk_number,
+                              chunk_number == chunks_info_.chunks_number_ - 1
+                                  ? chunks_info_.last_chunk_size_
+                                  : chunks_info_.max_chunk_size_);
+  RecordNextChunkOffset(chunk_number);
+}
+
+template <typename TapeType>
+void Tape<TapeType>::SeekToChunk(ChunksNumber chunk_number) {
+  stream_from_.clear();
+  if (format_ == TapeFormat::kBinary) {
+    stream_from_.seekg(BinaryCellOffset<TapeType>(
+        static_cast<uint64_t>(chunk_number) * chunks_info_.max_chunk_size_));
+    return;
+  }
+
+  if (!chunks_index_.Contains(0)) {
+    chunks_index_.Record(0, 0);
+  }
+  ChunksNumber known = chunks_index_.GetKnownChunksNumber();
+  if (chunk_number < known) {
+    stream_from_.seekg(chunks_index_.Get(chunk_number));
+    return;
+  }
 
-  for (ChunkSize i = 0;
-       i < (current_chunk_number - 1) * chunks_info_.max_chunk_size_; i++) {
+  stream_from_.seekg(chunks_index_.Get(known - 1));
+  for (ChunksNumber i = known - 1; i < chunk_number; i++) {
     TapeType element;
-    stream_from_ >> element;
+    for (ChunkSize j = 0; j < chunks_info_.max_chunk_size_; j++) {
+      stream_from_ >> element;
+    }
+    RecordNextChunkOffset(i);
   }
+}
 
-  current_chunk_.ReadNewChunk(stream_from_, current_chunk_number - 1,
-                              chunks_info_.max_chunk_size_);
-  current_chunk_.MoveToRightEdge();
+template <typename TapeType>
+void Tape<TapeType>::RecordNextChunkOffset(ChunksNumber chunk_number) {
+  stream_from_.clear();
+  RecordChunkOffset(chunk_number + 1, stream_from_.tellg());
+}
+
+template <typename TapeType>
+void Tape<TapeType>::RecordChunkOffset(ChunksNumber chunk_number,
+                                       std::streampos offset) {
+  if (format_ == TapeFormat::kBinary ||
+      chunk_number >= chunks_info_.chunks_number_ ||
+      chunk_number > filled_ / std::max<ChunkSize>(
+                                   chunks_info_.max_chunk_size_, 1)) {
+    return;
+  }
+  chunks_index_.Record(chunk_number, offset);
 }
 
 template <typename TapeType>
-void Tape<TapeType>::RewriteFromTo(std::fstream &from, std::fstream &to) {
-  TapeType element;
-  while (from >> element) {
-    to << element << ' ';
+void Tape<TapeType>::StartPrefetch(ChunksNumber chunk_number) {
+  if (!prefetch_ || next_chunk_.valid() ||
+      chunk_number >= chunks_info_.chunks_number_ ||
+      static_cast<uint64_t>(chunk_number) * chunks_info_.max_chunk_size_ >=
+          filled_) {
+    return;
+  }
+  std::streampos offset;
+  if (format_ == TapeFormat::kBinary) {
+    offset = BinaryCellOffset<TapeType>(static_cast<uint64_t>(chunk_number) *
+                                        chunks_info_.max_chunk_size_);
+  } else if (chunks_index_.Contains(chunk_number)) {
+    offset = chunks_index_.Get(chunk_number);
+  } else {
+    return;
+  }
+  if (!prefetch_stream_) {
+    prefetch_stream_ = std::make_shared<std::fstream>(
+        tape_location_, OpenMode(format_, std::ios::in));
   }
+  if (!prefetch_reader_) {
+    prefetch_reader_ = std::make_unique<ThreadPool>(1);
+  }
+
+  ChunkSize size = chunk_number == chunks_info_.chunks_number_ - 1
+                       ? chunks_info_.last_chunk_size_
+                       : chunks_info_.max_chunk_size_;
+  Chunk<TapeType> chunk(context_, chunk_number, chunks_info_.max_chunk_size_,
+                        format_);
+  chunk.ReturnElements(std::move(spare_elements_));
+  next_chunk_number_ = chunk_number;
+  next_chunk_ = prefetch_reader_->Submit(
+      [stream = prefetch_stream_, offset, chunk_number, size,
+       chunk = std::move(chunk)]() mutable {
+        stream->clear();
+        stream->seekg(offset);
+        chunk.ReadNewChunk(*stream, chunk_number, size);
+        stream->clear();
+        std::streampos next_offset = stream->tellg();
+        return std::pair<Chunk<TapeType>, std::streampos>(std::move(chunk),
+                                                          next_offset);
+      });
+}
+
+template <typename TapeType>
+bool Tape<TapeType>::TakePrefetchedChunk(ChunksNumber chunk_number) {
+  if (!next_chunk_.valid()) {
+    return false;
+  }
+  if (next_chunk_number_ != chunk_number) {
+    DropPrefetch();
+    return false;
+  }
+  auto [chunk, next_offset] = next_chunk_.get();
+  spare_elements_ = current_chunk_.TakeElements();
+  current_chunk_ = std::move(chunk);
+  RecordChunkOffset(chunk_number + 1, next_offset);
+  return true;
+}
+
+template <typename TapeType>
+void Tape<TapeType>::DropPrefetch() {
+  if (next_chunk_.valid()) {
+    next_chunk_.wait();
+    next_chunk_ = {};
+  }
+}
+
+template <typename TapeType>
+TapeSize Tape<TapeType>::CountFilledCells() const {
+  std::error_code error;
+  uintmax_t file_size = std::filesystem::file_size(tape_location_, error);
+  if (error || file_size == 0) {
+    return 0;
+  }
+  if (format_ == TapeFormat::kBinary) {
+    if (file_size < static_cast<uintmax_t>(BinaryTapeHeader::kSize)) {
+      return 0;
+    }
+    return static_cast<TapeSize>((file_size - BinaryTapeHeader::kSize) /
+                                 sizeof(TapeType));
+  }
+  return size_;
+}
+
+template <typename TapeType>
+void Tape<TapeType>::OpenStream() {
+  stream_from_.open(tape_location_,
+                    OpenMode(format_, std::ios::in | std::ios::out));
 }
 
 template <typename TapeType>
@@ -601,7 +1284,8 @@ void Tape<TapeType>::PutElementInNewChunk(std::fstream &to, ChunkSize size,
 
 template <typename TapeType>
 ChunkSize Tape<TapeType>::CalculateChunkSize(MemorySize memory, TapeSize size) {
-  return std::min(memory / kDivider, size);
+  return std::min<TapeSize>(memory / (kBuffersNumber * sizeof(TapeType)),
+                            size);
 }
 
 template <typename TapeType>
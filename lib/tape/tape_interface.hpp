@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <filesystem>
+#include <span>
 
 namespace tape {
 
@@ -52,5 +53,76 @@ class ITape {
   /// \return true if the move succeeded else false.
   //////////////////////////////////////////////////////////////////////////////
   virtual bool MoveLeft() = 0;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Read consecutive elements starting from the cell indicated by the
+  /// magnetic head and move the tape to the left by their number. If the
+  /// block reaches the last cell, the head stays on it and the tape is at its
+  /// end: the next blocks read nothing until the head is moved to the right
+  /// or to a cell.
+  ///
+  /// \param elements buffer for the read elements.
+  /// \return number of read elements, 0 at the end of the tape.
+  //////////////////////////////////////////////////////////////////////////////
+  virtual TapeSize ReadBlock(std::span<T> elements);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Put consecutive elements starting from the cell indicated by the
+  /// magnetic head and move the tape to the left by their number. If the
+  /// block reaches the last cell, the head stays on it and the tape is at its
+  /// end: the next blocks put nothing until the head is moved to the right or
+  /// to a cell.
+  ///
+  /// \param elements new elements.
+  /// \return number of put elements, 0 at the end of the tape.
+  //////////////////////////////////////////////////////////////////////////////
+  virtual TapeSize WriteBlock(std::span<const T> elements);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Check if a block has consumed the last cell of the tape.
+  ///
+  /// \return true if the tape is at its end else false.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] bool AtEnd() const;
+
+ protected:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief A block has consumed the last cell. Moves of the head to the
+  /// right or to a cell clear it.
+  //////////////////////////////////////////////////////////////////////////////
+  bool at_end_ = false;
 };
+
+template <typename T>
+TapeSize ITape<T>::ReadBlock(std::span<T> elements) {
+  TapeSize read = 0;
+  for (T &element : elements) {
+    if (at_end_) {
+      break;
+    }
+    element = ReadCell();
+    read++;
+    at_end_ = !MoveLeft();
+  }
+  return read;
+}
+
+template <typename T>
+TapeSize ITape<T>::WriteBlock(std::span<const T> elements) {
+  TapeSize written = 0;
+  for (const T &element : elements) {
+    if (at_end_) {
+      break;
+    }
+    WriteToCell(element);
+    written++;
+    at_end_ = !MoveLeft();
+  }
+  return written;
+}
+
+template <typename T>
+bool ITape<T>::AtEnd() const {
+  return at_end_;
+}
 }  // namespace tape
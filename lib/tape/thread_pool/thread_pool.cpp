@@ -0,0 +1,52 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+namespace tape {
+ThreadPool::ThreadPool(std::size_t threads_number) {
+  threads_number = std::max<std::size_t>(threads_number, 1);
+  workers_.reserve(threads_number);
+  for (std::size_t i = 0; i < threads_number; i++) {
+    workers_.emplace_back([this]() { Work(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  condition_.notify_all();
+  for (std::thread &worker : workers_) {
+    worker.join();
+  }
+}
+
+std::size_t ThreadPool::GetThreadsNumber() const {
+  return workers_.size();
+}
+
+void ThreadPool::Push(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push(std::move(task));
+  }
+  condition_.notify_one();
+}
+
+void ThreadPool::Work() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() { return stopped_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop();
+    }
+    task();
+  }
+}
+}  // namespace tape
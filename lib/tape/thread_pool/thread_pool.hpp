@@ -0,0 +1,93 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Fixed number of worker threads executing submitted tasks.
+////////////////////////////////////////////////////////////////////////////////
+class ThreadPool {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief ThreadPool constructor. Starts the workers.
+  ///
+  /// \param threads_number number of worker threads (at least one).
+  //////////////////////////////////////////////////////////////////////////////
+  explicit ThreadPool(std::size_t threads_number);
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief ThreadPool destructor. Finishes the submitted tasks and joins the
+  /// workers.
+  //////////////////////////////////////////////////////////////////////////////
+  ~ThreadPool();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Submit a task.
+  ///
+  /// \param task callable without arguments.
+  /// \return future result of the task.
+  //////////////////////////////////////////////////////////////////////////////
+  template <typename Task>
+  std::future<std::invoke_result_t<Task>> Submit(Task task);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of worker threads.
+  ///
+  /// \return number of worker threads.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::size_t GetThreadsNumber() const;
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Put a task in the queue.
+  //////////////////////////////////////////////////////////////////////////////
+  void Push(std::function<void()> task);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Loop of a worker thread.
+  //////////////////////////////////////////////////////////////////////////////
+  void Work();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Worker threads.
+  //////////////////////////////////////////////////////////////////////////////
+  std::vector<std::thread> workers_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Tasks waiting for a worker.
+  //////////////////////////////////////////////////////////////////////////////
+  std::queue<std::function<void()>> tasks_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Mutex guarding the queue.
+  //////////////////////////////////////////////////////////////////////////////
+  std::mutex mutex_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Signals new tasks and stopping.
+  //////////////////////////////////////////////////////////////////////////////
+  std::condition_variable condition_;
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief The pool is being destroyed.
+  //////////////////////////////////////////////////////////////////////////////
+  bool stopped_ = false;
+};
+
+template <typename Task>
+std::future<std::invoke_result_t<Task>> ThreadPool::Submit(Task task) {
+  using Result = std::invoke_result_t<Task>;
+  auto packaged_task =
+      std::make_shared<std::packaged_task<Result()>>(std::move(task));
+  std::future<Result> result = packaged_task->get_future();
+  Push([packaged_task]() { (*packaged_task)(); });
+  return result;
+}
+}  // namespace tape
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "../chunk/chunk.hpp"
+#include "../format/tape_format.hpp"
+#include "../tape_interface.hpp"
+
+namespace tape {
+////////////////////////////////////////////////////////////////////////////////
+/// \brief Sequential (append-only) writer of a tape. Elements are collected in
+/// a buffer of one chunk and the buffer is flushed to the file at once, so
+/// writing a tape of N elements costs O(N) file I/O.
+///
+/// \tparam TapeType type of elements in the tape.
+////////////////////////////////////////////////////////////////////////////////
+template <typename TapeType>
+class TapeWriter {
+ public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief TapeWriter default constructor.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeWriter() = default;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief TapeWriter constructor. The file is truncated. Throws
+  /// std::runtime_error if the file can not be opened.
+  ///
+  /// \param file path to the file where the tape will be written.
+  /// \param buffer_size number of elements buffered before flushing.
+  /// \param context delays in writing and shifting, and the memory budget.
+  /// \param format format of the file.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeWriter(const std::filesystem::path &file, ChunkSize buffer_size,
+             const TapeContext &context, TapeFormat format = TapeFormat::kText);
+
+  TapeWriter(const TapeWriter &) = delete;
+  TapeWriter &operator=(const TapeWriter &) = delete;
+
+  TapeWriter(TapeWriter &&) noexcept = default;
+  TapeWriter &operator=(TapeWriter &&) noexcept = default;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief TapeWriter destructor. Flushes the rest of the buffer; errors are
+  /// reported only by an explicit Close.
+  //////////////////////////////////////////////////////////////////////////////
+  ~TapeWriter();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Append an element to the end of the tape.
+  ///
+  /// \param element new element.
+  //////////////////////////////////////////////////////////////////////////////
+  void Write(const TapeType &element);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Append elements to the end of the tape. When the buffer is empty
+  /// and the elements fill it, they are written without copying.
+  ///
+  /// \param elements new elements.
+  //////////////////////////////////////////////////////////////////////////////
+  void WriteChunk(std::span<const TapeType> elements);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Write the buffered elements to the file. Throws
+  /// std::runtime_error if they can not be written.
+  //////////////////////////////////////////////////////////////////////////////
+  void Flush();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Flush the buffer, free it and close the file. Throws
+  /// std::runtime_error if the tape can not be written.
+  //////////////////////////////////////////////////////////////////////////////
+  void Close();
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the number of elements written (including buffered ones).
+  ///
+  /// \return number of elements written.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] TapeSize GetWrittenSize() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the path to the file where the tape is written.
+  ///
+  /// \return path to the file where the tape is written.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] std::filesystem::path GetTapeFilePath() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Get the format of the file where the tape is written.
+  ///
+  /// \return tape format.
+  //////////////////////////////////////////////////////////////////////////////
+  [[nodiscard]] TapeFormat GetFormat() const;
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Throw std::runtime_error naming the tape if the last operation on
+  /// the file stream failed.
+  //////////////////////////////////////////////////////////////////////////////
+  void CheckStream() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief File stream where the tape is written.
+  //////////////////////////////////////////////////////////////////////////////
+  std::fstream stream_to_;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Path to the file where the tape is written.
+  //////////////////////////////////////////////////////////////////////////////
+  std::filesystem::path tape_location_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of elements buffered before flushing.
+  //////////////////////////////////////////////////////////////////////////////
+  ChunkSize buffer_size_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Delays in writing and shifting, and the memory budget.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeContext context_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Format of the file where the tape is written.
+  //////////////////////////////////////////////////////////////////////////////
+  TapeFormat format_ = TapeFormat::kText;
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Elements that are not yet written to the file.
+  //////////////////////////////////////////////////////////////////////////////
+  BudgetVector<TapeType> buffer_{};
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \brief Number of elements written (including buffered ones).
+  //////////////////////////////////////////////////////////////////////////////
+  TapeSize written_size_{};
+};
+
+template <typename TapeType>
+TapeWriter<TapeType>::TapeWriter(const std::filesystem::path &file,
+                                 ChunkSize buffer_size,
+                                 const TapeContext &context,
+                                 TapeFormat format)
+    : tape_location_(file),
+      buffer_size_(std::max<ChunkSize>(buffer_size, 1)),
+      context_(context),
+      format_(format),
+      buffer_(BudgetAllocator<TapeType>(context.budget_)) {
+  stream_to_.open(tape_location_,
+                  OpenMode(format_, std::fstream::out | std::fstream::trunc));
+  if (!stream_to_.is_open()) {
+    throw std::runtime_error("Can not open tape " + tape_location_.string());
+  }
+  if (format_ == TapeFormat::kBinary) {
+    BinaryTapeHeader::For<TapeType>(0).Write(stream_to_);
+    CheckStream();
+  }
+}
+
+template <typename TapeType>
+TapeWriter<TapeType>::~TapeWriter() {
+  try {
+    Close();
+  } catch (...) {
+    // A destructor must not throw, Close reports the errors.
+  }
+}
+
+template <typename TapeType>
+void TapeWriter<TapeType>::Write(const TapeType &element) {
+  if (buffer_.empty()) {
+    // Allocated by the first buffered element: writers of whole chunks never
+    // allocate the buffer.
+    buffer_.reserve(buffer_size_);
+  }
+  buffer_.push_back(element);
+  written_size_++;
+  if (buffer_.size() >= buffer_size_) {
+    Flush();
+  }
+}
+
+template <typename TapeType>
+void TapeWriter<TapeType>::WriteChunk(std::span<const TapeType> elements) {
+  if (!buffer_.empty() || elements.size() < buffer_size_ ||
+      !stream_to_.is_open()) {
+    for (const TapeType &element : elements) {
+      Write(element);
+    }
+    return;
+  }
+  context_.WaitForShift(elements.size());
+  context_.WaitForWriting(elements.size());
+  context_.Count(TapeCounter::kBytesWritten,
+                elements.size() * sizeof(TapeType));
+  WriteElements(stream_to_, elements, format_);
+  CheckStream();
+  written_size_ += elements.size();
+}
+
+template <typename TapeType>
+void TapeWriter<TapeType>::Flush() {
+  if (!stream_to_.is_open()) {
+    return;
+  }
+  context_.WaitForShift(buffer_.size());
+  context_.WaitForWriting(buffer_.size());
+  context_.Count(TapeCounter::kBytesWritten, buffer_.size() * sizeof(TapeType));
+  WriteElements(stream_to_, std::span<const TapeType>(buffer_), format_);
+  buffer_.clear();
+  CheckStream();
+}
+
+template <typename TapeType>
+void TapeWriter<TapeType>::Close() {
+  if (!stream_to_.is_open()) {
+    return;
+  }
+  Flush();
+  if (format_ == TapeFormat::kBinary) {
+    BinaryTapeHeader::UpdateElementsNumber(stream_to_, written_size_);
+    CheckStream();
+  }
+  stream_to_.close();
+  buffer_.clear();
+  buffer_.shrink_to_fit();
+  CheckStream();
+}
+
+template <typename TapeType>
+void TapeWriter<TapeType>::CheckStream() const {
+  if (stream_to_.fail()) {
+    throw std::runtime_error("Can not write tape " + tape_location_.string());
+  }
+}
+
+template <typename TapeType>
+TapeSize TapeWriter<TapeType>::GetWrittenSize() const {
+  return written_size_;
+}
+
+template <typename TapeType>
+std::filesystem::path TapeWriter<TapeType>::GetTapeFilePath() const {
+  return tape_location_;
+}
+
+template <typename TapeType>
+TapeFormat TapeWriter<TapeType>::GetFormat() const {
+  return format_;
+}
+}  // namespace tape
@@ -2,11 +2,100 @@
 
 #include <gtest/gtest.h>
 
+#include <array>
+#include <atomic>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
 #include "../lib/config_reader/simple_yaml_reader.hpp"
 
-TEST(TapeStructure, EmptyTapeTest) {
-  const std::filesystem::path path = "./resources/config0.yaml";
+namespace {
+// Ordering that tells that the blocks of the split are being sorted.
+struct SortingLess {
+  bool operator()(int32_t lhs, int32_t rhs) const {
+    sorting = true;
+    return lhs < rhs;
+  }
+
+  static inline std::atomic<bool> sorting{false};
+};
+
+// Ordering that throws at its first comparison.
+struct ThrowingLess {
+  bool operator()(int32_t, int32_t) const {
+    throw std::runtime_error("comparison failed");
+  }
+};
+
+// Writes the elements to the text tape at the path.
+template <typename T>
+void WriteTape(const std::filesystem::path &path,
+               const std::vector<T> &elements) {
+  std::ofstream fout(path);
+  for (const T &element : elements) {
+    fout << element << ' ';
+  }
+}
+
+// Writes random elements from [min, max] to the text tape at the path and
+// returns them in the order of the tape.
+std::vector<int32_t> WriteRandomTape(const std::filesystem::path &path,
+                                     std::size_t size, uint32_t seed,
+                                     int32_t min = -1000000,
+                                     int32_t max = 1000000) {
+  std::mt19937 generator(seed);
+  std::uniform_int_distribution<int32_t> distribution(min, max);
+  std::vector<int32_t> elements(size);
+  for (int32_t &element : elements) {
+    element = distribution(generator);
+  }
+  WriteTape(path, elements);
+  return elements;
+}
+
+// Reads all elements of the text tape at the path.
+template <typename T = int32_t>
+std::vector<T> ReadTape(const std::filesystem::path &path) {
+  std::ifstream fin(path);
+  std::vector<T> elements;
+  T element;
+  while (fin >> element) {
+    elements.push_back(element);
+  }
+  return elements;
+}
+
+// Returns the elements in the order, equivalent elements keep their order.
+template <typename T, typename Compare = std::less<>>
+std::vector<T> Sorted(std::vector<T> elements, Compare compare = {}) {
+  std::stable_sort(elements.begin(), elements.end(), compare);
+  return elements;
+}
+
+// Sorts the text tape of size elements at path_in into path_out with the
+// memory, the options and the context, and expects the elements on the
+// output tape. Returns the sorter for the assertions on its runs and plan.
+template <typename T, typename Compare = std::less<>>
+tape::TapeSorter<T, Compare> SortAndExpect(
+    const std::filesystem::path &path_in, const std::filesystem::path &path_out,
+    tape::TapeSize size, tape::MemorySize memory,
+    const std::vector<T> &expected, const tape::SorterOptions &options = {},
+    const tape::TapeContext &context = {}) {
+  tape::Tape<T> tape_in(path_in, size, memory, context);
+  tape::Tape<T> tape_out(path_out, context);
+  tape::TapeSorter<T, Compare> sorter(tape_in, tape_out, options);
+  static_cast<void>(sorter.Sort());
+  EXPECT_EQ(ReadTape<T>(path_out), expected);
+  return sorter;
+}
 
+// Sorts the tape described by the config and returns the first line of the
+// output tape.
+std::string SortConfig(const std::filesystem::path &path) {
   config_reader::SimpleYamlReader config(path);
   config.ReadConfig();
 
@@ -36,124 +125,1047 @@ TEST(TapeStructure, EmptyTapeTest) {
 
   std::string result;
   std::getline(fin, result);
+  return result;
+}
+}  // namespace
 
+TEST(TapeStructure, EmptyTapeTest) {
   const std::string kExpected = "";
-  EXPECT_EQ(result, kExpected);
+  EXPECT_EQ(SortConfig("./resources/config0.yaml"), kExpected);
 }
 
 TEST(TapeStructure, TestFile1) {
-  const std::filesystem::path path = "./resources/config1.yaml";
+  const std::string kExpected =
+      "5 5 11 22 22 33 44 54 55 66 77 88 92 99 111 122 144 148 155 12345 ";
+  EXPECT_EQ(SortConfig("./resources/config1.yaml"), kExpected);
+}
 
-  config_reader::SimpleYamlReader config(path);
-  config.ReadConfig();
+TEST(TapeStructure, TestFile2) {
+  const std::string kExpected =
+      "5 5 11 22 22 33 44 54 55 66 77 88 92 99 111 122 144 148 155 12345 ";
+  EXPECT_EQ(SortConfig("./resources/config2.yaml"), kExpected);
+}
 
-  const size_t size = config["N"].AsInt32();
-  const size_t memory = config["M"].AsInt32();
+TEST(TapeStructure, TestFile3) {
+  const std::string kExpected =
+      "-21435246 -6374869 -675162 -76854 -48130 -9876"
+      " -6254 0 6 865 34578 56342 84613 87645 235646"
+      " 314526 358128 3481364 5343127 5463276 7231462"
+      " 8125637 8745637 56142738 61432576 659298456 ";
+  EXPECT_EQ(SortConfig("./resources/config3.yaml"), kExpected);
+}
 
-  const std::chrono::milliseconds delay_for_read =
-      config["delay_for_read"].AsMilliseconds();
-  const std::chrono::milliseconds delay_for_write =
-      config["delay_for_write"].AsMilliseconds();
-  const std::chrono::milliseconds delay_for_shift =
-      config["delay_for_shift"].AsMilliseconds();
+TEST(TapeStructure, SequentialWriteToCell) {
+  const std::filesystem::path path_out = "./utests/sequential_write.out";
+  std::filesystem::remove(path_out);
 
-  const std::filesystem::path path_in = config["path_in"].AsPath();
-  const std::filesystem::path path_out = config["path_out"].AsPath();
+  const std::chrono::milliseconds delay = std::chrono::milliseconds::zero();
+  tape::Tape<int32_t> tape(path_out, 5, 64, delay, delay, delay);
 
-  tape::Tape<int32_t> tape_in(path_in, size, memory, delay_for_read,
-                              delay_for_write, delay_for_shift);
-  tape::Tape<int32_t> tape_out(path_out, delay_for_read, delay_for_write,
-                               delay_for_shift);
+  for (int32_t element : {3, -1, 4, 1, -5}) {
+    tape.WriteToCell(element);
+    tape.MoveLeft();
+  }
 
-  tape::TapeSorter sorter(tape_in, tape_out);
+  std::ifstream fin(path_out);
 
-  sorter.Sort();
+  std::string result;
+  std::getline(fin, result);
 
-  std::ifstream fin(path_out);
+  const std::string kExpected = "3 -1 4 1 -5 ";
+  EXPECT_EQ(result, kExpected);
+}
+
+TEST(TapeStructure, BinaryFormatConversion) {
+  const std::filesystem::path path_in = "./resources/input3.in";
+  const std::filesystem::path path_binary = "./utests/input3.bin";
+  const std::filesystem::path path_text = "./utests/input3.txt";
+
+  EXPECT_EQ(tape::ConvertTextToBinary<int32_t>(path_in, path_binary), 26);
+  EXPECT_EQ(tape::ConvertBinaryToText<int32_t>(path_binary, path_text), 26);
+
+  const std::chrono::milliseconds delay = std::chrono::milliseconds::zero();
+  tape::Tape<int32_t> tape_text(path_in, 26, 50, delay, delay, delay);
+  tape::Tape<int32_t> tape_binary(path_binary, 26, 50, delay, delay, delay,
+                                  tape::TapeFormat::kBinary);
+  do {
+    EXPECT_EQ(tape_text.ReadCell(), tape_binary.ReadCell());
+  } while (tape_text.MoveLeft() && tape_binary.MoveLeft());
+
+  std::ifstream fin(path_text);
 
   std::string result;
   std::getline(fin, result);
 
   const std::string kExpected =
-      "5 5 11 22 22 33 44 54 55 66 77 88 92 99 111 122 144 148 155 12345 ";
+      "-9876 314526 -6254 3481364 84613 -48130 235646 34578 5343127"
+      " 659298456 61432576 87645 -6374869 -76854 56142738 0 7231462"
+      " 5463276 -21435246 6 358128 56342 8745637 -675162 8125637 865 ";
   EXPECT_EQ(result, kExpected);
 }
 
-TEST(TapeStructure, TestFile2) {
-  const std::filesystem::path path = "./resources/config2.yaml";
+TEST(TapeStructure, ReverseScan) {
+  const std::filesystem::path path_in = "./resources/input3.in";
 
-  config_reader::SimpleYamlReader config(path);
-  config.ReadConfig();
+  const std::chrono::milliseconds delay = std::chrono::milliseconds::zero();
+  tape::Tape<int32_t> tape(path_in, 26, 50, delay, delay, delay);
 
-  const size_t size = config["N"].AsInt32();
-  const size_t memory = config["M"].AsInt32();
+  std::vector<int32_t> forward;
+  do {
+    forward.push_back(tape.ReadCell());
+  } while (tape.MoveLeft());
 
-  const std::chrono::milliseconds delay_for_read =
-      config["delay_for_read"].AsMilliseconds();
-  const std::chrono::milliseconds delay_for_write =
-      config["delay_for_write"].AsMilliseconds();
-  const std::chrono::milliseconds delay_for_shift =
-      config["delay_for_shift"].AsMilliseconds();
+  std::vector<int32_t> backward;
+  do {
+    backward.push_back(tape.ReadCell());
+  } while (tape.MoveRight());
+  std::reverse(backward.begin(), backward.end());
 
-  const std::filesystem::path path_in = config["path_in"].AsPath();
-  const std::filesystem::path path_out = config["path_out"].AsPath();
+  EXPECT_EQ(forward.size(), 26);
+  EXPECT_EQ(forward, backward);
 
-  tape::Tape<int32_t> tape_in(path_in, size, memory, delay_for_read,
-                              delay_for_write, delay_for_shift);
-  tape::Tape<int32_t> tape_out(path_out, delay_for_read, delay_for_write,
-                               delay_for_shift);
+  EXPECT_TRUE(tape.MoveToCell(13));
+  EXPECT_EQ(tape.ReadCell(), forward[13]);
+  EXPECT_TRUE(tape.MoveToCell(2));
+  EXPECT_EQ(tape.ReadCell(), forward[2]);
+  EXPECT_FALSE(tape.MoveToCell(26));
 
-  tape::TapeSorter sorter(tape_in, tape_out);
+}
+
+TEST(TapeStructure, MoveAndClone) {
+  const std::filesystem::path path_a = "./utests/move_a.in";
+  const std::filesystem::path path_b = "./utests/move_b.in";
+  const std::filesystem::path path_c = "./utests/move_c.in";
+  std::ofstream(path_a) << "1 2 3 4 5 6 7 8 9 10";
+  std::ofstream(path_b) << "0";
+  std::filesystem::remove(path_c);
+
+  auto read_all = [](tape::Tape<int32_t> &tape) {
+    std::vector<int32_t> elements;
+    do {
+      elements.push_back(tape.ReadCell());
+    } while (tape.MoveLeft());
+    return elements;
+  };
+  const std::vector<int32_t> expected{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
 
+  // A moved tape takes the file handle and continues where it was.
+  tape::Tape<int32_t> tape_a(path_a, 10, 16, tape::Delays{});
+  EXPECT_EQ(tape_a.ReadCell(), 1);
+  EXPECT_TRUE(tape_a.MoveLeft());
+  tape::Tape<int32_t> moved(std::move(tape_a));
+  EXPECT_EQ(moved.GetTapeFilePath(), path_a);
+  EXPECT_TRUE(tape_a.GetTapeFilePath().empty());
+  EXPECT_EQ(moved.ReadCell(), 2);
+
+  // A tape with its own file takes over the handle, the file is moved to its
+  // place explicitly.
+  tape::Tape<int32_t> tape_b(path_b, 1, 16, tape::Delays{});
+  tape_b = std::move(moved);
+  EXPECT_EQ(tape_b.GetTapeFilePath(), path_a);
+  tape_b.MoveTo(path_b);
+  EXPECT_EQ(tape_b.GetTapeFilePath(), path_b);
+  EXPECT_FALSE(std::filesystem::exists(path_a));
+  EXPECT_TRUE(tape_b.MoveToCell(0));
+  EXPECT_EQ(read_all(tape_b), expected);
+
+  // A file that can not be moved stays with the tape.
+  EXPECT_THROW(tape_b.MoveTo("./utests/missing_dir/move_b.in"),
+               std::filesystem::filesystem_error);
+  EXPECT_EQ(tape_b.GetTapeFilePath(), path_b);
+  EXPECT_TRUE(tape_b.MoveToCell(0));
+  EXPECT_EQ(read_all(tape_b), expected);
+
+  tape::Tape<int32_t> clone = tape_b.Clone(path_c);
+  EXPECT_EQ(clone.GetTapeFilePath(), path_c);
+  EXPECT_EQ(read_all(clone), expected);
+  EXPECT_TRUE(tape_b.MoveToCell(0));
+  EXPECT_EQ(read_all(tape_b), expected);
+}
+
+TEST(TapeStructure, RadixSortRun) {
+  std::mt19937_64 generator(7);
+  auto check = [&generator]<typename T>(std::size_t size, uint64_t range) {
+    std::vector<T> run(size);
+    for (T &element : run) {
+      element = static_cast<T>(range ? generator() % range : generator());
+    }
+    std::vector<T> expected = run;
+    std::sort(expected.begin(), expected.end());
+    tape::SortRun<T>(run);
+    EXPECT_EQ(run, expected);
+  };
+
+  check.operator()<int32_t>(100000, 0);
+  check.operator()<int32_t>(100000, 16);
+  check.operator()<int64_t>(100000, 0);
+  check.operator()<uint32_t>(100000, 0);
+  check.operator()<int16_t>(10000, 0);
+  check.operator()<uint8_t>(10000, 0);
+  check.operator()<int32_t>(100, 0);
+  check.operator()<double>(1000, 0);
+
+  std::vector<int32_t> extremes(1000, std::numeric_limits<int32_t>::max());
+  extremes[10] = std::numeric_limits<int32_t>::min();
+  extremes[500] = -1;
+  extremes[700] = 0;
+  tape::SortRun<int32_t>(extremes);
+  EXPECT_TRUE(std::is_sorted(extremes.begin(), extremes.end()));
+  EXPECT_EQ(extremes[0], std::numeric_limits<int32_t>::min());
+  EXPECT_EQ(extremes[1], -1);
+  EXPECT_EQ(extremes[2], 0);
+}
+
+TEST(TapeStructure, KWayMerge) {
+  const std::filesystem::path path_in = "./utests/kway_merge.in";
+  const std::filesystem::path path_out = "./utests/kway_merge.out";
+  std::vector<int32_t> elements = WriteRandomTape(path_in, 1000, 42);
+
+  auto sorter = SortAndExpect(path_in, path_out, 1000, 200, Sorted(elements));
+  EXPECT_EQ(sorter.GetRunsNumber(), 22);
+  EXPECT_EQ(sorter.GetFanIn(), 9);
+  EXPECT_EQ(sorter.GetMergePassesNumber(), 2);
+}
+
+TEST(TapeStructure, TwoRunMerge) {
+  const std::vector<int32_t> first{1, 3, 3, 5, 7, 9};
+  const std::vector<int32_t> second{2, 3, 4, 10};
+  std::vector<int32_t> output(4);
+  auto [taken_first, taken_second] = tape::MergeBlocks<int32_t>(
+      first, second, std::span<int32_t>(output));
+  EXPECT_EQ(output, (std::vector<int32_t>{1, 2, 3, 3}));
+  EXPECT_EQ(taken_first, 3);
+  EXPECT_EQ(taken_second, 1);
+
+  const std::filesystem::path path_in = "./utests/two_run_merge.in";
+  const std::filesystem::path path_out = "./utests/two_run_merge.out";
+  std::vector<int32_t> elements =
+      WriteRandomTape(path_in, 1000, 5, -1000, 1000);
+
+  // The memory is enough for merging two runs at once only.
+  const std::chrono::milliseconds delay(1);
+  tape::TapeContext context{tape::Delays{delay, delay, delay}};
+  context.clock_ = std::make_shared<tape::DeviceClock>();
+  tape::Tape<int32_t> tape_in(path_in, 1000, 64, context);
+  tape::Tape<int32_t> tape_out(path_out, context);
+  tape::TapeSorter sorter(tape_in, tape_out);
+  tape::SortCost cost =
+      tape::CostModel(context.delays_).Estimate(sorter.MakePlan());
   sorter.Sort();
+  EXPECT_EQ(sorter.GetFanIn(), 2);
+  EXPECT_GT(sorter.GetMergePassesNumber(), 5);
+  EXPECT_EQ(ReadTape(path_out), Sorted(elements));
 
-  std::ifstream fin(path_out);
+  double measured = std::chrono::duration<double, std::milli>(
+                        context.clock_->GetElapsed())
+                        .count();
+  EXPECT_NEAR(static_cast<double>(cost.time_.count()), measured,
+              measured * 0.02);
+}
 
-  std::string result;
-  std::getline(fin, result);
+TEST(TapeStructure, ReplacementSelectionSortedInput) {
+  const std::filesystem::path path_in = "./utests/replacement_selection.in";
+  const std::filesystem::path path_out = "./utests/replacement_selection.out";
+  std::vector<int32_t> elements(500);
+  for (int32_t i = 0; i < 500; i++) {
+    elements[i] = i * 3 - 700;
+  }
+  WriteTape(path_in, elements);
 
-  const std::string kExpected =
-      "5 5 11 22 22 33 44 54 55 66 77 88 92 99 111 122 144 148 155 12345 ";
-  EXPECT_EQ(result, kExpected);
+  tape::SorterOptions options;
+  options.run_generation_ = tape::RunGeneration::kReplacementSelection;
+  auto sorter = SortAndExpect(path_in, path_out, 500, 400, elements, options);
+  EXPECT_EQ(sorter.GetRunsNumber(), 1);
 }
 
-TEST(TapeStructure, TestFile3) {
-  const std::filesystem::path path = "./resources/config3.yaml";
+TEST(TapeStructure, ParallelSplit) {
+  const std::filesystem::path path_in = "./utests/parallel_split.in";
+  const std::filesystem::path path_out = "./utests/parallel_split.out";
+  std::vector<int32_t> elements = WriteRandomTape(path_in, 1000, 7);
 
-  config_reader::SimpleYamlReader config(path);
-  config.ReadConfig();
+  tape::SorterOptions options;
+  options.threads_ = 3;
+  auto sorter =
+      SortAndExpect(path_in, path_out, 1000, 400, Sorted(elements), options);
+  EXPECT_EQ(sorter.GetRunsNumber(), 63);
 
-  const size_t size = config["N"].AsInt32();
-  const size_t memory = config["M"].AsInt32();
+  // An error of a sorting thread reaches the writer thread, which stops the
+  // split; the error is thrown by Sort.
+  tape::Tape<int32_t> throwing_in(path_in, 1000, 400, tape::Delays{});
+  tape::Tape<int32_t> tape_out(path_out, tape::Delays{});
+  tape::TapeSorter<int32_t, ThrowingLess> throwing_sorter(throwing_in,
+                                                          tape_out, options);
+  EXPECT_THROW(static_cast<void>(throwing_sorter.Sort()), std::runtime_error);
+}
 
-  const std::chrono::milliseconds delay_for_read =
-      config["delay_for_read"].AsMilliseconds();
-  const std::chrono::milliseconds delay_for_write =
-      config["delay_for_write"].AsMilliseconds();
-  const std::chrono::milliseconds delay_for_shift =
-      config["delay_for_shift"].AsMilliseconds();
+TEST(TapeStructure, ParallelMergePass) {
+  const std::filesystem::path path_in = "./utests/parallel_merge_pass.in";
+  const std::filesystem::path path_out = "./utests/parallel_merge_pass.out";
+  std::vector<int32_t> elements = WriteRandomTape(path_in, 5000, 11);
 
-  const std::filesystem::path path_in = config["path_in"].AsPath();
-  const std::filesystem::path path_out = config["path_out"].AsPath();
+  tape::SorterOptions options;
+  options.threads_ = 3;
+  auto sorter =
+      SortAndExpect(path_in, path_out, 5000, 400, Sorted(elements), options);
+  EXPECT_EQ(sorter.GetMergePassesNumber(), 3);
+}
 
-  tape::Tape<int32_t> tape_in(path_in, size, memory, delay_for_read,
-                              delay_for_write, delay_for_shift);
-  tape::Tape<int32_t> tape_out(path_out, delay_for_read, delay_for_write,
-                               delay_for_shift);
+TEST(TapeStructure, PolyphaseMerge) {
+  // 17 runs on 3 input tapes are the perfect distribution 7, 6, 4.
+  tape::PolyphaseMerge schedule(4);
+  std::vector<tape::ChunksNumber> tape_runs(4);
+  for (tape::TapeSize run = 0; run < 17; run++) {
+    tape_runs[schedule.GetNextRunTape()]++;
+    schedule.AddRun(1);
+  }
+  EXPECT_EQ(tape_runs, (std::vector<tape::ChunksNumber>{7, 6, 4, 0}));
+  EXPECT_EQ(schedule.GetPhasesNumber(), 4);
+  EXPECT_EQ(schedule.GetMergesNumber(), 4);
+  for (tape::ChunksNumber phase = 0; phase < 3; phase++) {
+    for (tape::ChunksNumber merges = schedule.GetMergesNumber(); merges;
+         merges--) {
+      static_cast<void>(schedule.TakeMerge());
+    }
+    schedule.EndPhase();
+  }
+  EXPECT_EQ(schedule.GetMergesNumber(), 1);
+  EXPECT_EQ(schedule.TakeMerge(), (std::vector<tape::TapeSize>{0, 9, 5, 3}));
+
+  const std::filesystem::path path_in = "./utests/polyphase_merge.in";
+  const std::filesystem::path path_out = "./utests/polyphase_merge.out";
+  std::vector<int32_t> elements =
+      WriteRandomTape(path_in, 1000, 31, -1000, 1000);
+
+  const std::chrono::milliseconds delay(1);
+  tape::TapeContext context{tape::Delays{delay, delay, delay}};
+  context.clock_ = std::make_shared<tape::DeviceClock>();
+#ifdef TAPE_SORTER_STATS
+  context.counters_ = std::make_shared<tape::OperationCounters>();
+#endif
+  tape::Tape<int32_t> tape_in(path_in, 1000, 200, context);
+  tape::Tape<int32_t> tape_out(path_out, context);
+  tape::SorterOptions options;
+  options.merge_tapes_ = 4;
+  tape::TapeSorter sorter(tape_in, tape_out, options);
+  tape::SortPlan plan = sorter.MakePlan();
+  EXPECT_EQ(plan.merge_tapes_, 4);
+  tape::SortCost cost = tape::CostModel(context.delays_).Estimate(plan);
+  tape::SortStats stats = sorter.Sort();
+  EXPECT_EQ(sorter.GetFanIn(), 3);
+  EXPECT_EQ(stats.phases_.size(), sorter.GetMergePassesNumber() + 1);
+  EXPECT_EQ(stats.phases_.back().name_, "final merge");
+#ifdef TAPE_SORTER_STATS
+  EXPECT_EQ(stats.GetCount(tape::TapeCounter::kTempFiles), 4);
+#endif
+  EXPECT_EQ(ReadTape(path_out), Sorted(elements));
+
+  double measured = std::chrono::duration<double, std::milli>(
+                        context.clock_->GetElapsed())
+                        .count();
+  EXPECT_NEAR(static_cast<double>(cost.time_.count()), measured,
+              measured * 0.02);
+}
+
+TEST(TapeStructure, ReadBackwardMerge) {
+  // Read backward, every merge takes runs in one order, the last one
+  // ascending.
+  std::vector<bool> descending =
+      tape::PolyphaseMerge::PlanDescendingRuns(4, 17);
+  ASSERT_EQ(descending.size(), 17);
+  tape::PolyphaseMerge schedule(4, true);
+  for (bool run_descending : descending) {
+    schedule.AddRun(1, run_descending);
+  }
+  while (schedule.GetPhasesNumber() > 1) {
+    for (tape::ChunksNumber merges = schedule.GetMergesNumber(); merges;
+         merges--) {
+      EXPECT_NO_THROW(static_cast<void>(schedule.IsNextMergeDescending()));
+      static_cast<void>(schedule.TakeMerge());
+    }
+    schedule.EndPhase();
+  }
+  EXPECT_EQ(schedule.GetMergesNumber(), 1);
+  EXPECT_FALSE(schedule.IsNextMergeDescending());
+  std::vector<tape::TapeSize> merge = schedule.TakeMerge();
+  EXPECT_EQ(std::accumulate(merge.begin(), merge.end(), tape::TapeSize{0}), 17);
+
+  const std::filesystem::path path_in = "./utests/read_backward_merge.in";
+  const std::filesystem::path path_out = "./utests/read_backward_merge.out";
+  const std::vector<int32_t> expected =
+      Sorted(WriteRandomTape(path_in, 1000, 37, -1000, 1000));
+
+  for (uint32_t threads : {1, 2}) {
+    const std::chrono::milliseconds delay(1);
+    std::array<double, 2> measured{};
+    for (bool read_backward : {false, true}) {
+      tape::TapeContext context{tape::Delays{delay, delay, delay}};
+      context.clock_ = std::make_shared<tape::DeviceClock>();
+      tape::Tape<int32_t> tape_in(path_in, 1000, 200, context);
+      tape::Tape<int32_t> tape_out(path_out, context);
+      tape::SorterOptions options;
+      options.threads_ = threads;
+      options.merge_tapes_ = 4;
+      options.read_backward_ = read_backward;
+      tape::TapeSorter sorter(tape_in, tape_out, options);
+      tape::SortPlan plan = sorter.MakePlan();
+      EXPECT_EQ(plan.read_backward_, read_backward);
+      tape::SortCost cost = tape::CostModel(context.delays_).Estimate(plan);
+      static_cast<void>(sorter.Sort());
+      EXPECT_EQ(ReadTape(path_out), expected);
+
+      measured[read_backward] = std::chrono::duration<double, std::milli>(
+                                    context.clock_->GetElapsed())
+                                    .count();
+      EXPECT_NEAR(static_cast<double>(cost.time_.count()),
+                  measured[read_backward], measured[read_backward] * 0.02);
+    }
+    // No rewinds and no moves back over the read chunks.
+    EXPECT_LT(measured[1], measured[0]);
+  }
+
+  // The short last chunk of a tape is read first, the full chunks after it
+  // fit in the buffer planned by the memory of the tape.
+  const std::filesystem::path path_budgeted =
+      "./utests/read_backward_budgeted.in";
+  std::vector<int32_t> budgeted =
+      WriteRandomTape(path_budgeted, 1191, 38, -1000, 1000);
+  tape::TapeContext context;
+  context.budget_ = std::make_shared<tape::MemoryBudget>(2125);
+  tape::SorterOptions options;
+  options.merge_tapes_ = 7;
+  options.read_backward_ = true;
+  auto sorter = SortAndExpect(path_budgeted, path_out, budgeted.size(), 2125,
+                              Sorted(budgeted), options, context);
+  EXPECT_TRUE(sorter.MakePlan().read_backward_);
+  EXPECT_LE(context.budget_->GetPeak(), 2125);
+}
+
+TEST(TapeStructure, StableRecordSort) {
+  using Record = tape::Record<int32_t, uint32_t>;
+  const std::filesystem::path path_in = "./utests/stable_record_sort.in";
+  const std::filesystem::path path_out = "./utests/stable_record_sort.out";
+  // Few keys, the payload is the number of the record in the input tape.
+  std::mt19937 generator(41);
+  std::uniform_int_distribution<int32_t> distribution(-10, 10);
+  std::vector<Record> records(3000);
+  for (uint32_t i = 0; i < records.size(); i++) {
+    records[i] = Record{distribution(generator), i};
+  }
+  WriteTape(path_in, records);
+  const std::vector<Record> expected =
+      Sorted(records, [](const Record &lhs, const Record &rhs) {
+        return lhs.key_ < rhs.key_;
+      });
+
+  // The scratch buffer of half the run is taken from the budget.
+  std::vector<Record> run(expected.rbegin(), expected.rend());
+  const std::size_t scratch_memory = run.size() / 2 * sizeof(Record);
+  auto scratch_budget =
+      std::make_shared<tape::MemoryBudget>(scratch_memory - 1);
+  EXPECT_THROW((tape::SortRun<Record, tape::RecordKey>(std::span(run),
+                                                       scratch_budget)),
+               tape::BudgetExceeded);
+  scratch_budget = std::make_shared<tape::MemoryBudget>(scratch_memory);
+  tape::SortRun<Record, tape::RecordKey>(std::span(run), scratch_budget);
+  EXPECT_EQ(scratch_budget->GetPeak(), scratch_memory);
+  EXPECT_EQ(scratch_budget->GetUsed(), 0);
+  EXPECT_TRUE(std::equal(run.begin(), run.end(), expected.begin(),
+                         [](const Record &lhs, const Record &rhs) {
+                           return lhs.key_ == rhs.key_;
+                         }));
+  for (std::size_t i = 1; i < run.size(); i++) {
+    if (run[i - 1].key_ == run[i].key_) {
+      EXPECT_GT(run[i - 1].payload_, run[i].payload_);
+    }
+  }
+
+  std::vector<tape::SorterOptions> variants(6);
+  variants[1].run_generation_ = tape::RunGeneration::kReplacementSelection;
+  variants[2].threads_ = 3;
+  variants[3].prefetch_ = true;
+  variants[4].mapped_merge_ = true;
+  variants[5].merge_tapes_ = 4;
+  for (const tape::SorterOptions &options : variants) {
+    tape::TapeContext context;
+    // The scratch buffers of the stable sorts fit in the memory of the tape.
+    context.budget_ = std::make_shared<tape::MemoryBudget>(800);
+    auto sorter = SortAndExpect(path_in, path_out, expected.size(), 800,
+                                expected, options, context);
+    EXPECT_EQ(sorter.MakePlan().merge_tapes_, 0);
+    EXPECT_GT(sorter.GetRunsNumber(), 2);
+    EXPECT_LE(context.budget_->GetPeak(), 800);
+  }
+}
+
+TEST(TapeStructure, OrderPolicies) {
+  std::mt19937 generator(43);
+  std::uniform_int_distribution<int32_t> distribution(-1000, 1000);
+  std::vector<int32_t> run(5000);
+  for (int32_t &element : run) {
+    element = distribution(generator);
+  }
+  std::vector<int32_t> descending = run;
+  tape::SortRun<int32_t, tape::WholeKey, tape::Descending<>>(
+      std::span<int32_t>(descending));
+  EXPECT_EQ(descending, Sorted(run, std::greater<>{}));
+  EXPECT_FALSE((tape::kIsStableOrder<tape::WholeKey, tape::Descending<>>));
+  EXPECT_TRUE((tape::kIsStableOrder<tape::WholeKey, tape::ByAbsoluteValue<>>));
+  EXPECT_EQ(tape::AbsoluteValue{}(std::numeric_limits<int32_t>::min()),
+            uint32_t{1} << 31);
+
+  const std::filesystem::path path_in = "./utests/order_policies.in";
+  const std::filesystem::path path_out = "./utests/order_policies.out";
+  std::vector<int32_t> input(run.begin(), run.begin() + 2000);
+  WriteTape(path_in, input);
+
+  std::vector<tape::SorterOptions> variants(3);
+  variants[1].run_generation_ = tape::RunGeneration::kReplacementSelection;
+  variants[2].merge_tapes_ = 4;
+  variants[2].read_backward_ = true;
+  for (const tape::SorterOptions &options : variants) {
+    SortAndExpect<int32_t, tape::Descending<>>(
+        path_in, path_out, input.size(), 400, Sorted(input, std::greater<>{}),
+        options);
+  }
+
+  // Equivalent elements keep their order.
+  const std::vector<int32_t> by_absolute_value =
+      Sorted(input, [](int32_t lhs, int32_t rhs) {
+        return std::abs(lhs) < std::abs(rhs);
+      });
+  for (const tape::SorterOptions &options : variants) {
+    auto sorter = SortAndExpect<int32_t, tape::ByAbsoluteValue<>>(
+        path_in, path_out, input.size(), 400, by_absolute_value, options);
+    EXPECT_EQ(sorter.MakePlan().merge_tapes_, 0);
+  }
+
+  struct LastDigit {
+    int32_t operator()(int32_t value) const { return value % 10; }
+  };
+  SortAndExpect<int32_t, tape::ByProjection<LastDigit, tape::Descending<>>>(
+      path_in, path_out, input.size(), 400,
+      Sorted(input, [](int32_t lhs, int32_t rhs) {
+        return lhs % 10 > rhs % 10;
+      }));
+}
+
+TEST(TapeStructure, AggregatingSort) {
+  std::vector<int32_t> run{3, 3, 1, 3, 2, 2, 5};
+  std::sort(run.begin(), run.end());
+  run.resize(tape::CombineRun<std::less<>>(tape::Aggregation::kUnique,
+                                           std::span<int32_t>(run)));
+  EXPECT_EQ(run, (std::vector<int32_t>{1, 2, 3, 5}));
+  EXPECT_EQ(tape::ParseAggregation("count"), tape::Aggregation::kCount);
+  EXPECT_THROW(static_cast<void>(tape::ParseAggregation("sum")),
+               std::invalid_argument);
+
+  const std::filesystem::path path_in = "./utests/aggregating_sort.in";
+  const std::filesystem::path path_out = "./utests/aggregating_sort.out";
+  std::vector<int32_t> input = WriteRandomTape(path_in, 2000, 47, -30, 30);
+  const std::vector<int32_t> sorted = Sorted(input);
+  std::vector<int32_t> unique = sorted;
+  unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+  std::vector<tape::SorterOptions> variants(8);
+  variants[1].run_generation_ = tape::RunGeneration::kReplacementSelection;
+  variants[2].threads_ = 3;
+  variants[3].prefetch_ = true;
+  variants[4].mapped_merge_ = true;
+  variants[5].merge_tapes_ = 4;
+  variants[6].merge_tapes_ = 4;
+  variants[6].read_backward_ = true;
+  variants[7].merge_tapes_ = 3;
+  variants[7].run_generation_ = tape::RunGeneration::kReplacementSelection;
+  for (tape::SorterOptions options : variants) {
+    // Duplicates are dropped before the runs are written, so less is written.
+    const std::chrono::milliseconds delay(1);
+    std::array<double, 2> measured{};
+    for (tape::Aggregation aggregation :
+         {tape::Aggregation::kNone, tape::Aggregation::kUnique}) {
+      const bool is_unique = aggregation == tape::Aggregation::kUnique;
+      tape::TapeContext context{tape::Delays{delay, delay, delay}};
+      context.clock_ = std::make_shared<tape::DeviceClock>();
+      options.aggregation_ = aggregation;
+      auto sorter =
+          SortAndExpect(path_in, path_out, input.size(), 400,
+                        is_unique ? unique : sorted, options, context);
+      EXPECT_GT(sorter.GetRunsNumber(), 2);
+      measured[is_unique] = std::chrono::duration<double, std::milli>(
+                                context.clock_->GetElapsed())
+                                .count();
+    }
+    EXPECT_LT(measured[1], measured[0]);
+  }
+
+  // The counts of the keys are added up, the first record keeps its key.
+  using Count = tape::Record<int32_t, uint32_t>;
+  std::vector<Count> records;
+  std::map<int32_t, uint32_t> counts;
+  for (int32_t element : input) {
+    records.push_back(Count{element, 1});
+    counts[element]++;
+  }
+  WriteTape(path_in, records);
+  std::vector<Count> expected_counts;
+  for (auto [key, key_count] : counts) {
+    expected_counts.push_back(Count{key, key_count});
+  }
+  for (tape::SorterOptions options : variants) {
+    options.aggregation_ = tape::Aggregation::kCount;
+    SortAndExpect(path_in, path_out, input.size(), 800, expected_counts,
+                  options);
+  }
+
+  tape::SorterOptions options;
+  options.aggregation_ = tape::Aggregation::kCount;
+  tape::Tape<int32_t> tape_in(path_in, input.size(), 400, tape::Delays{});
+  tape::Tape<int32_t> tape_out(path_out, tape::Delays{});
+  EXPECT_THROW(tape::TapeSorter(tape_in, tape_out, options),
+               std::invalid_argument);
+}
+
+TEST(TapeStructure, PrefetchScan) {
+  const std::filesystem::path path_in = "./resources/input3.in";
+
+  const std::chrono::milliseconds delay = std::chrono::milliseconds::zero();
+  tape::Tape<int32_t> tape(path_in, 26, 50, delay, delay, delay);
+  tape::Tape<int32_t> prefetched_tape(path_in, 26, 50, delay, delay, delay);
+  prefetched_tape.SetPrefetch(true);
+
+  std::vector<int32_t> expected;
+  do {
+    expected.push_back(tape.ReadCell());
+  } while (tape.MoveLeft());
+
+  // The chunks are read by one reader thread of the tape, which is started
+  // with the first prefetched chunk and not for every chunk.
+  const std::filesystem::path tasks = "/proc/self/task";
+  auto threads_number = [&tasks]() {
+    return std::distance(std::filesystem::directory_iterator(tasks),
+                         std::filesystem::directory_iterator{});
+  };
+  std::vector<int32_t> forward{prefetched_tape.ReadCell()};
+  const auto scan_threads_number =
+      std::filesystem::exists(tasks) ? threads_number() : 0;
+  while (prefetched_tape.MoveLeft()) {
+    forward.push_back(prefetched_tape.ReadCell());
+    if (scan_threads_number) {
+      EXPECT_EQ(threads_number(), scan_threads_number);
+    }
+  }
+  EXPECT_EQ(forward, expected);
+
+  std::vector<int32_t> backward;
+  do {
+    backward.push_back(prefetched_tape.ReadCell());
+  } while (prefetched_tape.MoveRight());
+  std::reverse(backward.begin(), backward.end());
+  EXPECT_EQ(backward, expected);
+}
+
+TEST(TapeStructure, ChunkBufferReuse) {
+  const std::filesystem::path path = "./utests/chunk_buffer_reuse.in";
+  std::ofstream fout(path);
+  fout << "5 3 8 1 7 2 6 4";
+  fout.close();
+
+  std::fstream fin(path, std::ios::in);
+  tape::Chunk<int32_t> chunk(tape::Delays{}, 0, 4, tape::TapeFormat::kText);
+  chunk.ReadNewChunk(fin, 0, 4);
+  const int32_t *data = chunk.GetChunkElements().data();
+  EXPECT_TRUE(std::ranges::equal(chunk.GetChunkElements(),
+                                 std::vector<int32_t>{5, 3, 8, 1}));
+
+  // The elements are moved out and back without copying, and the next chunk
+  // is read into the same buffer.
+  tape::BudgetVector<int32_t> elements = chunk.TakeElements();
+  EXPECT_EQ(elements.data(), data);
+  std::sort(elements.begin(), elements.end());
+  chunk.ReturnElements(std::move(elements));
+  chunk.ReadNewChunk(fin, 1, 4);
+  EXPECT_EQ(chunk.GetChunkElements().data(), data);
+  EXPECT_TRUE(std::ranges::equal(chunk.GetChunkElements(),
+                                 std::vector<int32_t>{7, 2, 6, 4}));
+
+  // A scan to the left starts on the short last chunk of 3 elements. The
+  // buffer is allocated for the largest chunk of 5 at once, not grown by
+  // doubling when that chunk is read.
+  tape::TapeContext context;
+  context.budget_ = std::make_shared<tape::MemoryBudget>(5 * sizeof(int32_t));
+  tape::Chunk<int32_t> tail_chunk(context, 0, 5, tape::TapeFormat::kText);
+  fin.clear();
+  fin.seekg(0);
+  fin >> std::ws;
+  for (int skip = 0; skip < 5; skip++) {
+    int32_t element;
+    fin >> element;
+  }
+  tail_chunk.ReadNewChunk(fin, 1, 3);
+  EXPECT_TRUE(std::ranges::equal(tail_chunk.GetChunkElements(),
+                                 std::vector<int32_t>{2, 6, 4}));
+  fin.clear();
+  fin.seekg(0);
+  tail_chunk.ReadNewChunk(fin, 0, 5);
+  EXPECT_TRUE(std::ranges::equal(tail_chunk.GetChunkElements(),
+                                 std::vector<int32_t>{5, 3, 8, 1, 7}));
+  EXPECT_EQ(context.budget_->GetPeak(), 5 * sizeof(int32_t));
+}
+
+TEST(TapeStructure, MappedTape) {
+  const std::filesystem::path path = "./utests/mapped.bin";
+  const tape::Delays delays{};
+
+  {
+    tape::MappedTape<int32_t> tape(path, 100, 64, delays);
+    for (int32_t i = 0; i < 100; i++) {
+      tape.WriteToCell(i * i - 50);
+      tape.MoveLeft();
+    }
+    tape.Flush();
+  }
+
+  tape::MappedTape<int32_t> tape(path, 64, delays);
+  EXPECT_EQ(tape.GetSize(), 100);
+  EXPECT_EQ(tape.GetWindowSize(), 4);
+  EXPECT_THROW(tape.WriteToCell(0), std::runtime_error);
 
+  std::vector<int32_t> forward;
+  do {
+    forward.push_back(tape.ReadCell());
+  } while (tape.MoveLeft());
+  ASSERT_EQ(forward.size(), 100);
+  EXPECT_EQ(forward[7], 7 * 7 - 50);
+
+  std::vector<int32_t> backward;
+  do {
+    backward.push_back(tape.ReadCell());
+  } while (tape.MoveRight());
+  std::reverse(backward.begin(), backward.end());
+  EXPECT_EQ(forward, backward);
+}
+
+TEST(TapeStructure, MappedMerge) {
+  const std::filesystem::path path_in = "./utests/mapped_merge.in";
+  const std::filesystem::path path_out = "./utests/mapped_merge.out";
+  std::vector<int32_t> elements = WriteRandomTape(path_in, 1000, 13);
+
+  tape::SorterOptions options;
+  options.mapped_merge_ = true;
+  SortAndExpect(path_in, path_out, 1000, 400, Sorted(elements), options);
+}
+
+TEST(TapeStructure, BlockReadWrite) {
+  const std::filesystem::path path_in = "./resources/input3.in";
+  const std::filesystem::path path_binary = "./utests/block.bin";
+
+  const std::chrono::milliseconds delay = std::chrono::milliseconds::zero();
+  tape::Tape<int32_t> tape_in(path_in, 26, 50, delay, delay, delay);
+  std::vector<int32_t> expected;
+  do {
+    expected.push_back(tape_in.ReadCell());
+  } while (tape_in.MoveLeft());
+
+  tape::Tape<int32_t> tape_text(path_in, 26, 50, delay, delay, delay);
+  std::vector<int32_t> elements(30);
+  EXPECT_EQ(tape_text.ReadBlock(std::span(elements).first(10)), 10);
+  EXPECT_EQ(tape_text.ReadCell(), expected[10]);
+  EXPECT_EQ(tape_text.ReadBlock(std::span(elements).subspan(10)), 16);
+  EXPECT_EQ(tape_text.ReadCell(), expected[25]);
+  elements.resize(26);
+  EXPECT_EQ(elements, expected);
+
+  // The last cell is consumed once: the next blocks read nothing until the
+  // head is moved.
+  EXPECT_TRUE(tape_text.AtEnd());
+  EXPECT_EQ(tape_text.ReadBlock(std::span(elements)), 0);
+  EXPECT_TRUE(tape_text.MoveRight());
+  EXPECT_FALSE(tape_text.AtEnd());
+  EXPECT_EQ(tape_text.ReadBlock(std::span(elements)), 2);
+  EXPECT_TRUE(tape_text.MoveToCell(0));
+  std::vector<int32_t> blocks;
+  std::array<int32_t, 4> block{};
+  while (tape::TapeSize read = tape_text.ReadBlock(block)) {
+    blocks.insert(blocks.end(), block.begin(), block.begin() + read);
+  }
+  EXPECT_EQ(blocks, expected);
+
+  std::filesystem::remove(path_binary);
+  tape::Tape<int32_t> tape_binary(path_binary, 26, 64, delay, delay, delay,
+                                  tape::TapeFormat::kBinary);
+  EXPECT_EQ(tape_binary.WriteBlock(std::span(expected).first(7)), 7);
+  EXPECT_EQ(tape_binary.WriteBlock(std::span(expected).subspan(7)), 19);
+  EXPECT_EQ(tape_binary.WriteBlock(std::span(expected)), 0);
+
+  tape::MappedTape<int32_t> mapped(path_binary, 64, tape::Delays{});
+  std::vector<int32_t> result(26);
+  EXPECT_EQ(mapped.ReadBlock(result), 26);
+  EXPECT_EQ(result, expected);
+  EXPECT_TRUE(mapped.AtEnd());
+  EXPECT_EQ(mapped.ReadBlock(result), 0);
+  EXPECT_TRUE(mapped.MoveToCell(20));
+  EXPECT_EQ(mapped.ReadBlock(result), 6);
+}
+
+TEST(TapeStructure, WriterErrors) {
+  // A file that can not be created is reported at once instead of buffering
+  // the elements that would never reach the disk.
+  tape::TapeContext context;
+  context.budget_ = std::make_shared<tape::MemoryBudget>(64);
+  EXPECT_THROW(tape::TapeWriter<int32_t>("./utests/no_such_dir/run.bin", 4,
+                                         context, tape::TapeFormat::kBinary),
+               std::runtime_error);
+  EXPECT_EQ(context.budget_->GetUsed(), 0);
+
+  // The writes to a full device fail at the latest when the tape is closed.
+  tape::TapeWriter<int32_t> writer("/dev/full", 4, context);
+  EXPECT_THROW(
+      {
+        for (int32_t i = 0; i < 1000; i++) {
+          writer.Write(i);
+        }
+        writer.Close();
+      },
+      std::runtime_error);
+}
+
+TEST(TapeStructure, VirtualDelays) {
+  const std::filesystem::path path_in = "./utests/virtual_delays.in";
+  const std::filesystem::path path_out = "./utests/virtual_delays.out";
+  std::vector<int32_t> elements = WriteRandomTape(path_in, 1000, 17);
+
+  const std::chrono::milliseconds delay = std::chrono::seconds(1);
+  tape::TapeContext context{tape::Delays{delay, delay, delay}};
+  context.clock_ = std::make_shared<tape::DeviceClock>();
+
+  context.WaitForShift(5);
+  EXPECT_EQ(context.clock_->GetElapsed(tape::DeviceOperation::kShift),
+            std::chrono::seconds(5));
+  context.clock_->Reset();
+
+  const auto start = std::chrono::steady_clock::now();
+  auto sorter = SortAndExpect(path_in, path_out, 1000, 400, Sorted(elements),
+                              {}, context);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+
+  EXPECT_GE(context.clock_->GetElapsed(tape::DeviceOperation::kWriting),
+            std::chrono::seconds(1000 * (sorter.GetMergePassesNumber() + 1)));
+  EXPECT_GE(context.clock_->GetElapsed(tape::DeviceOperation::kReading),
+            std::chrono::seconds(1000));
+}
+
+TEST(TapeStructure, CostModel) {
+  const std::filesystem::path path_in = "./utests/cost_model.in";
+  const std::filesystem::path path_out = "./utests/cost_model.out";
+  WriteRandomTape(path_in, 5000, 23);
+
+  const std::chrono::milliseconds delay(1);
+  for (tape::RunGeneration run_generation :
+       {tape::RunGeneration::kChunkSort,
+        tape::RunGeneration::kReplacementSelection}) {
+    tape::TapeContext context{tape::Delays{delay, delay, delay}};
+    context.clock_ = std::make_shared<tape::DeviceClock>();
+
+    tape::Tape<int32_t> tape_in(path_in, 5000, 200, context);
+    tape::Tape<int32_t> tape_out(path_out, context);
+    tape::SorterOptions options;
+    options.run_generation_ = run_generation;
+    tape::TapeSorter sorter(tape_in, tape_out, options);
+
+    tape::SortPlan plan = sorter.MakePlan();
+    tape::SortCost cost = tape::CostModel(context.delays_).Estimate(plan);
+    sorter.Sort();
+
+    EXPECT_NEAR(static_cast<double>(plan.runs_number_),
+                sorter.GetRunsNumber(), plan.runs_number_ * 0.1);
+    EXPECT_EQ(cost.phases_.size(), sorter.GetMergePassesNumber() + 1);
+    double measured = std::chrono::duration<double, std::milli>(
+                          context.clock_->GetElapsed())
+                          .count();
+    EXPECT_NEAR(static_cast<double>(cost.time_.count()), measured,
+                measured * 0.02);
+  }
+}
+
+TEST(TapeStructure, SortStats) {
+  const std::filesystem::path path_in = "./utests/sort_stats.in";
+  const std::filesystem::path path_out = "./utests/sort_stats.out";
+  WriteRandomTape(path_in, 5000, 29);
+
+  tape::TapeContext context;
+#ifdef TAPE_SORTER_STATS
+  context.counters_ = std::make_shared<tape::OperationCounters>();
+#endif
+  tape::Tape<int32_t> tape_in(path_in, 5000, 200, context);
+  tape::Tape<int32_t> tape_out(path_out, context);
   tape::TapeSorter sorter(tape_in, tape_out);
 
-  sorter.Sort();
+  tape::SortStats stats = sorter.Sort();
 
-  std::ifstream fin(path_out);
+  ASSERT_EQ(stats.phases_.size(), sorter.GetMergePassesNumber() + 1);
+  EXPECT_EQ(stats.phases_.front().name_, "split");
+  EXPECT_EQ(stats.phases_.back().name_, "final merge");
+  EXPECT_NE(stats.ToJson().find("\"final merge\""), std::string::npos);
 
-  std::string result;
-  std::getline(fin, result);
+#ifdef TAPE_SORTER_STATS
+  tape::ChunksNumber passes = sorter.GetMergePassesNumber();
+  EXPECT_EQ(stats.GetCount(tape::TapeCounter::kCellsWritten),
+            5000 * (passes + 1));
+  EXPECT_EQ(stats.GetCount(tape::TapeCounter::kBytesWritten),
+            5000 * (passes + 1) * sizeof(int32_t));
+  EXPECT_GE(stats.GetCount(tape::TapeCounter::kCellsRead), 5000 * (passes + 1));
+  EXPECT_GE(stats.GetCount(tape::TapeCounter::kChunkLoads),
+            sorter.GetRunsNumber());
+  EXPECT_GE(stats.GetCount(tape::TapeCounter::kTempFiles),
+            sorter.GetRunsNumber());
+  EXPECT_EQ(stats.counts_, context.counters_->GetCounts());
+  EXPECT_NE(stats.ToJson().find("\"temp_files\""), std::string::npos);
+#endif
+}
 
-  const std::string kExpected =
-      "-21435246 -6374869 -675162 -76854 -48130 -9876"
-      " -6254 0 6 865 34578 56342 84613 87645 235646"
-      " 314526 358128 3481364 5343127 5463276 7231462"
-      " 8125637 8745637 56142738 61432576 659298456 ";
-  EXPECT_EQ(result, kExpected);
+TEST(TapeStructure, MemoryPlanner) {
+  tape::SorterOptions options;
+  tape::MemoryPlanner<int32_t> planner(1600, options);
+  tape::MemoryPlanner<int64_t> wide_planner(1600, options);
+
+  // A chunk sorted in place takes the whole memory but the reserve.
+  EXPECT_EQ(planner.GetSplitChunkSize(), 375);
+  EXPECT_EQ(wide_planner.GetSplitChunkSize(), 187);
+  EXPECT_EQ(planner.GetFanIn(1000), 91);
+  EXPECT_EQ(planner.GetMergeBlockSize(91), 4);
+  EXPECT_EQ(planner.GetFanIn(1000, 2), 44);
+
+  // The scratch buffer of a stable sort takes half of the chunk more.
+  tape::MemoryPlanner<int32_t> stable_planner(1600, options, true);
+  EXPECT_EQ(stable_planner.GetSplitChunkSize(), 250);
+  options.threads_ = 2;
+  EXPECT_EQ(tape::MemoryPlanner<int32_t>(1600, options).GetSplitBlockSize(),
+            82);
+  EXPECT_EQ(
+      tape::MemoryPlanner<int32_t>(1600, options, true).GetSplitBlockSize(),
+      65);
+
+  // Many threads in little memory: only the merges and the sorting threads
+  // with blocks of the smallest sizes run at once.
+  options.threads_ = 32;
+  tape::MemoryPlanner<int32_t> threads_planner(400, options);
+  EXPECT_EQ(threads_planner.GetMergesNumber(), 5);
+  EXPECT_EQ(threads_planner.GetSplitThreadsNumber(), 18);
+  EXPECT_EQ(threads_planner.GetSplitBlockSize(), 4);
+  tape::MemoryPlanner<tape::Record<int32_t, uint32_t>> records_planner(
+      128, options);
+  EXPECT_EQ(records_planner.GetMergesNumber(), 1);
+  EXPECT_EQ(records_planner.GetSplitThreadsNumber(), 1);
+  options.threads_ = 1;
+
+  options.prefetch_ = true;
+  EXPECT_EQ(tape::MemoryPlanner<int32_t>(1600, options).GetSplitChunkSize(),
+            187);
+
+  options.run_generation_ = tape::RunGeneration::kReplacementSelection;
+  tape::MemoryPlanner<int32_t> heap_planner(1600, options);
+  EXPECT_EQ(heap_planner.GetSplitChunkSize(), 46);
+  EXPECT_EQ(heap_planner.GetHeapSize(), 117);
+
+  const std::filesystem::path path_in = "./utests/memory_planner.in";
+  const std::filesystem::path path_out = "./utests/memory_planner.out";
+  std::vector<int32_t> ascending(1000);
+  std::iota(ascending.begin(), ascending.end(), 1);
+  WriteTape(path_in, Sorted(ascending, std::greater<>{}));
+
+  tape::Tape<int32_t> tape_in(path_in, 1000, 1600, tape::Delays{});
+  EXPECT_EQ(tape_in.GetMaxChunkSize(), 100);
+
+  auto sorter = SortAndExpect(path_in, path_out, 1000, 1600, ascending);
+  EXPECT_EQ(sorter.GetRunsNumber(), 3);
+}
+
+TEST(TapeStructure, MemoryBudget) {
+  auto budget = std::make_shared<tape::MemoryBudget>(64);
+  tape::BudgetVector<int32_t> elements(
+      16, tape::BudgetAllocator<int32_t>(budget));
+  EXPECT_EQ(budget->GetUsed(), 64);
+  EXPECT_THROW(elements.push_back(0), tape::BudgetExceeded);
+  elements = tape::BudgetVector<int32_t>(tape::BudgetAllocator<int32_t>(budget));
+  EXPECT_EQ(budget->GetUsed(), 0);
+  EXPECT_EQ(budget->GetPeak(), 64);
+
+  const std::filesystem::path path_in = "./utests/memory_budget.in";
+  const std::filesystem::path path_out = "./utests/memory_budget.out";
+  std::vector<int32_t> ascending(1000);
+  std::iota(ascending.begin(), ascending.end(), 1);
+  WriteTape(path_in, Sorted(ascending, std::greater<>{}));
+
+  std::vector<tape::SorterOptions> all_options(3);
+  all_options[1].run_generation_ = tape::RunGeneration::kReplacementSelection;
+  all_options[2].threads_ = 2;
+  for (const tape::SorterOptions &options : all_options) {
+    // The budget is half of the memory of the tape, the sort fits in it.
+    tape::TapeContext context;
+    context.budget_ = std::make_shared<tape::MemoryBudget>(800);
+    SortAndExpect(path_in, path_out, 1000, 1600, ascending, options, context);
+    EXPECT_GT(context.budget_->GetPeak(), 0);
+    EXPECT_LE(context.budget_->GetPeak(), 800);
+  }
+
+  // With many threads and little memory, fewer merges and sorting threads
+  // run at once, so that all of them fit in the budget.
+  using Record = tape::Record<int32_t, uint32_t>;
+  const std::filesystem::path path_records = "./utests/memory_budget_records.in";
+  std::mt19937 generator(47);
+  std::vector<Record> records(1000);
+  for (uint32_t i = 0; i < records.size(); i++) {
+    records[i] = Record{static_cast<int32_t>(generator() % 100), i};
+  }
+  WriteTape(path_records, records);
+  const std::vector<Record> sorted_records =
+      Sorted(records, [](const Record &lhs, const Record &rhs) {
+        return lhs.key_ < rhs.key_;
+      });
+  for (auto [memory, threads] : {std::pair<uint32_t, uint32_t>{512, 32},
+                                 {128, 8},
+                                 {64, 4}}) {
+    tape::TapeContext context;
+    context.budget_ = std::make_shared<tape::MemoryBudget>(memory);
+    tape::SorterOptions options;
+    options.threads_ = threads;
+    EXPECT_NO_THROW(SortAndExpect(path_records, path_out, 1000, memory,
+                                  sorted_records, options, context));
+    EXPECT_LE(context.budget_->GetPeak(), memory);
+  }
+  {
+    tape::TapeContext context;
+    context.budget_ = std::make_shared<tape::MemoryBudget>(400);
+    tape::SorterOptions options;
+    options.threads_ = 32;
+    options.prefetch_ = true;
+    EXPECT_NO_THROW(SortAndExpect(path_in, path_out, 1000, 400, ascending,
+                                  options, context));
+    EXPECT_LE(context.budget_->GetPeak(), 400);
+  }
+
+  // Another sort sharing the budget takes every freed byte once the blocks
+  // are sorted: the sort cannot allocate its next buffer, and Sort throws
+  // instead of terminating the process.
+  tape::TapeContext context;
+  context.budget_ = std::make_shared<tape::MemoryBudget>(800);
+  tape::Tape<int32_t> tape_in(path_in, 1000, 1600, context);
+  tape::Tape<int32_t> tape_out(path_out, context);
+  tape::TapeSorter<int32_t, SortingLess> sorter(tape_in, tape_out,
+                                                all_options[2]);
+  std::atomic<bool> sorted = false;
+  std::size_t taken = 0;
+  std::thread neighbour([&context, &sorted, &taken]() {
+    while (!sorted) {
+      std::size_t available = context.budget_->GetAvailable();
+      if (SortingLess::sorting && available &&
+          context.budget_->TryAcquire(available)) {
+        taken += available;
+      }
+    }
+  });
+  EXPECT_THROW(static_cast<void>(sorter.Sort()), tape::BudgetExceeded);
+  sorted = true;
+  neighbour.join();
+  context.budget_->Release(taken);
+  SortingLess::sorting = false;
 }